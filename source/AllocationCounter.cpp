@@ -0,0 +1,78 @@
+#pragma once
+#include "pch.h"
+#include "AllocationCounter.h"
+
+#ifdef _DEBUG
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+//Replaces the global operator new/delete to count every allocation, used to verify the render loop doesn't allocate
+static std::atomic<uint64_t> g_HeapAllocationCount{ 0 };
+static thread_local bool g_IsCountingAllocations = false; //Set by HeapAllocationScope
+
+void* operator new(size_t size)
+{
+	if (g_IsCountingAllocations)
+		++g_HeapAllocationCount;
+	void* pMemory = std::malloc((size == 0) ? 1 : size);
+	if (!pMemory)
+		throw std::bad_alloc();
+	return pMemory;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* pMemory) noexcept
+{
+	std::free(pMemory);
+}
+
+void operator delete[](void* pMemory) noexcept
+{
+	std::free(pMemory);
+}
+
+void operator delete(void* pMemory, size_t) noexcept
+{
+	std::free(pMemory);
+}
+
+void operator delete[](void* pMemory, size_t) noexcept
+{
+	std::free(pMemory);
+}
+
+uint64_t GetHeapAllocationCount()
+{
+	return g_HeapAllocationCount;
+}
+
+HeapAllocationScope::HeapAllocationScope()
+	: m_WasCounting(g_IsCountingAllocations)
+{
+	g_IsCountingAllocations = true;
+}
+
+HeapAllocationScope::~HeapAllocationScope()
+{
+	g_IsCountingAllocations = m_WasCounting;
+}
+#else
+uint64_t GetHeapAllocationCount()
+{
+	return 0;
+}
+
+HeapAllocationScope::HeapAllocationScope()
+	: m_WasCounting(false)
+{
+}
+
+HeapAllocationScope::~HeapAllocationScope()
+{
+}
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+
+/* Returns amount of heap allocations made through operator new since the program started, by threads inside of a HeapAllocationScope
+	Only tracked in debug builds, release builds always return 0 */
+uint64_t GetHeapAllocationCount();
+
+/* Counts the heap allocations of the calling thread while alive (scopes can nest)
+	Threads outside of a scope (texture loaders...) aren't counted, so they don't show up in the allocations of a frame */
+class HeapAllocationScope final
+{
+public:
+	HeapAllocationScope();
+	~HeapAllocationScope();
+
+	HeapAllocationScope(const HeapAllocationScope& h) = delete;
+	HeapAllocationScope(HeapAllocationScope&& h) = delete;
+	HeapAllocationScope& operator=(const HeapAllocationScope& h) = delete;
+	HeapAllocationScope& operator=(HeapAllocationScope&& h) = delete;
+
+private:
+	bool m_WasCounting;
+};
@@ -0,0 +1,281 @@
+#pragma once
+#include "pch.h"
+#include "BRDFKernels.h"
+#include "BRDF.h"
+
+#include <immintrin.h>
+#include <random>
+#include <cassert>
+
+//MSVC allows the use of any intrinsic without changing the target architecture, GCC and Clang need to know per function
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+//========SCALAR========
+static void PhongScalar(BRDFPacket& packet)
+{
+	for (int32_t lane = 0; lane < BRDF_PACKET_WIDTH; ++lane)
+	{
+		const FVector3 normal{ packet.NormalX[lane], packet.NormalY[lane], packet.NormalZ[lane] };
+		const FVector3 view{ packet.ViewX[lane], packet.ViewY[lane], packet.ViewZ[lane] };
+		const FVector3 light{ packet.LightX[lane], packet.LightY[lane], packet.LightZ[lane] };
+
+		const RGBColor result = BRDF::Phong(packet.SpecularReflectance[lane], packet.Shininess[lane], light, view, normal);
+		packet.R[lane] = result.r;
+		packet.G[lane] = result.g;
+		packet.B[lane] = result.b;
+	}
+}
+
+static void LambertCookTorranceScalar(BRDFPacket& packet)
+{
+	for (int32_t lane = 0; lane < BRDF_PACKET_WIDTH; ++lane)
+	{
+		const FVector3 normal{ packet.NormalX[lane], packet.NormalY[lane], packet.NormalZ[lane] };
+		const FVector3 view{ packet.ViewX[lane], packet.ViewY[lane], packet.ViewZ[lane] };
+		const FVector3 light{ packet.LightX[lane], packet.LightY[lane], packet.LightZ[lane] };
+		const RGBColor albedo{ packet.AlbedoR[lane], packet.AlbedoG[lane], packet.AlbedoB[lane] };
+		const int metalness = (packet.Metalness[lane] > 0.5f) ? 1 : 0;
+
+		const RGBColor result = BRDF::LambertCookTorrance(albedo, metalness, packet.Roughness[lane], light, view, normal);
+		packet.R[lane] = result.r;
+		packet.G[lane] = result.g;
+		packet.B[lane] = result.b;
+	}
+}
+
+//========AVX2========
+TARGET_AVX2 static inline __m256 Clamp01(__m256 v)
+{
+	return _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+}
+
+TARGET_AVX2 static inline __m256 Dot(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz)
+{
+	return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz));
+}
+
+/* log2 of positive, normal floats: exponent + polynomial of the mantissa
+	The mantissa is moved to [sqrt(0.5), sqrt(2)), where the series of 2 * atanh(t) / ln(2) with t = (m - 1) / (m + 1)
+	converges fast enough to stop after t^7 (truncation error below 5e-8) */
+TARGET_AVX2 static inline __m256 Log2(__m256 v)
+{
+	const __m256i bits = _mm256_castps_si256(v);
+	__m256i exponent = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127));
+	__m256 mantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F800000)));
+
+	const __m256 isAboveSqrt2 = _mm256_cmp_ps(mantissa, _mm256_set1_ps(1.41421356f), _CMP_GT_OQ);
+	mantissa = _mm256_blendv_ps(mantissa, _mm256_mul_ps(mantissa, _mm256_set1_ps(0.5f)), isAboveSqrt2);
+	exponent = _mm256_sub_epi32(exponent, _mm256_castps_si256(isAboveSqrt2)); //Mask is -1 where true
+
+	const __m256 one = _mm256_set1_ps(1.f);
+	const __m256 t = _mm256_div_ps(_mm256_sub_ps(mantissa, one), _mm256_add_ps(mantissa, one));
+	const __m256 t2 = _mm256_mul_ps(t, t);
+	__m256 series = _mm256_set1_ps(2.f / (7.f * 0.69314718f));
+	series = _mm256_add_ps(_mm256_mul_ps(series, t2), _mm256_set1_ps(2.f / (5.f * 0.69314718f)));
+	series = _mm256_add_ps(_mm256_mul_ps(series, t2), _mm256_set1_ps(2.f / (3.f * 0.69314718f)));
+	series = _mm256_add_ps(_mm256_mul_ps(series, t2), _mm256_set1_ps(2.f / 0.69314718f));
+	return _mm256_add_ps(_mm256_cvtepi32_ps(exponent), _mm256_mul_ps(series, t));
+}
+
+/* 2^v: 2^round(v) straight into the exponent bits, times a degree 6 taylor polynomial of 2^f with f in [-0.5, 0.5]
+	(truncation error below 1.3e-7 relative) */
+TARGET_AVX2 static inline __m256 Exp2(__m256 v)
+{
+	v = _mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(-126.f)), _mm256_set1_ps(126.f));
+	const __m256 rounded = _mm256_round_ps(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	const __m256 f = _mm256_sub_ps(v, rounded);
+
+	//ln(2)^k / k!
+	__m256 polynomial = _mm256_set1_ps(1.5403530e-4f);
+	polynomial = _mm256_add_ps(_mm256_mul_ps(polynomial, f), _mm256_set1_ps(1.3333558e-3f));
+	polynomial = _mm256_add_ps(_mm256_mul_ps(polynomial, f), _mm256_set1_ps(9.6181291e-3f));
+	polynomial = _mm256_add_ps(_mm256_mul_ps(polynomial, f), _mm256_set1_ps(5.5504109e-2f));
+	polynomial = _mm256_add_ps(_mm256_mul_ps(polynomial, f), _mm256_set1_ps(2.4022651e-1f));
+	polynomial = _mm256_add_ps(_mm256_mul_ps(polynomial, f), _mm256_set1_ps(6.9314718e-1f));
+	polynomial = _mm256_add_ps(_mm256_mul_ps(polynomial, f), _mm256_set1_ps(1.f));
+
+	const __m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(rounded), _mm256_set1_epi32(127)), 23);
+	return _mm256_mul_ps(polynomial, _mm256_castsi256_ps(exponent));
+}
+
+/* base^exponent for base in [0, 1] and exponents >= 0, 0^exponent = 0 for positive exponents and x^0 = 1 (0^0 included) like powf
+	Log2(0) is finite (-127), so an exponent of 0 already gives Exp2(0) = 1, only positive exponents of 0 get masked */
+TARGET_AVX2 static inline __m256 Pow(__m256 base, __m256 exponent)
+{
+	const __m256 result = Exp2(_mm256_mul_ps(exponent, Log2(base)));
+	const __m256 zero = _mm256_setzero_ps();
+	return _mm256_and_ps(result, _mm256_or_ps(_mm256_cmp_ps(base, zero, _CMP_GT_OQ), _mm256_cmp_ps(exponent, zero, _CMP_LE_OQ)));
+}
+
+TARGET_AVX2 static void PhongAVX2(BRDFPacket& packet)
+{
+	const __m256 nx = _mm256_loadu_ps(packet.NormalX), ny = _mm256_loadu_ps(packet.NormalY), nz = _mm256_loadu_ps(packet.NormalZ);
+	const __m256 lx = _mm256_loadu_ps(packet.LightX), ly = _mm256_loadu_ps(packet.LightY), lz = _mm256_loadu_ps(packet.LightZ);
+
+	//Reflect the light around the normal
+	const __m256 twoDotNL = _mm256_mul_ps(_mm256_set1_ps(2.f), Dot(nx, ny, nz, lx, ly, lz));
+	const __m256 rx = _mm256_sub_ps(lx, _mm256_mul_ps(twoDotNL, nx));
+	const __m256 ry = _mm256_sub_ps(ly, _mm256_mul_ps(twoDotNL, ny));
+	const __m256 rz = _mm256_sub_ps(lz, _mm256_mul_ps(twoDotNL, nz));
+
+	const __m256 specStrength = Clamp01(Dot(rx, ry, rz, _mm256_loadu_ps(packet.ViewX), _mm256_loadu_ps(packet.ViewY), _mm256_loadu_ps(packet.ViewZ)));
+	const __m256 result = _mm256_mul_ps(_mm256_loadu_ps(packet.SpecularReflectance), Pow(specStrength, _mm256_loadu_ps(packet.Shininess)));
+
+	_mm256_storeu_ps(packet.R, result);
+	_mm256_storeu_ps(packet.G, result);
+	_mm256_storeu_ps(packet.B, result);
+}
+
+/* Fresnel, diffuse and the sum of both for a single color channel of the Cook-Torrance BRDF */
+TARGET_AVX2 static inline void ShadeChannelAVX2(const float* pAlbedo, float* pResult, __m256 isMetal, __m256 fresnelFactor, __m256 specularFactor)
+{
+	const __m256 one = _mm256_set1_ps(1.f);
+	const __m256 albedo = _mm256_loadu_ps(pAlbedo);
+	const __m256 f0 = _mm256_blendv_ps(_mm256_set1_ps(0.04f), albedo, isMetal);
+	const __m256 fresnel = _mm256_add_ps(f0, _mm256_mul_ps(_mm256_sub_ps(one, f0), fresnelFactor));
+
+	//Metals don't have a diffuse part
+	const __m256 kd = _mm256_andnot_ps(isMetal, _mm256_sub_ps(one, fresnel));
+	const __m256 diffuse = _mm256_mul_ps(_mm256_mul_ps(albedo, kd), _mm256_set1_ps(1.f / float(E_PI)));
+	_mm256_storeu_ps(pResult, _mm256_add_ps(diffuse, _mm256_mul_ps(fresnel, specularFactor)));
+}
+
+TARGET_AVX2 static void LambertCookTorranceAVX2(BRDFPacket& packet)
+{
+	const __m256 one = _mm256_set1_ps(1.f);
+	const __m256 invPi = _mm256_set1_ps(1.f / float(E_PI));
+	const __m256 nx = _mm256_loadu_ps(packet.NormalX), ny = _mm256_loadu_ps(packet.NormalY), nz = _mm256_loadu_ps(packet.NormalZ);
+	const __m256 vx = _mm256_loadu_ps(packet.ViewX), vy = _mm256_loadu_ps(packet.ViewY), vz = _mm256_loadu_ps(packet.ViewZ);
+	const __m256 lx = _mm256_loadu_ps(packet.LightX), ly = _mm256_loadu_ps(packet.LightY), lz = _mm256_loadu_ps(packet.LightZ);
+	const __m256 isMetal = _mm256_cmp_ps(_mm256_loadu_ps(packet.Metalness), _mm256_set1_ps(0.5f), _CMP_GT_OQ);
+	const __m256 roughness = _mm256_loadu_ps(packet.Roughness);
+	const __m256 roughnessSquared = _mm256_mul_ps(roughness, roughness);
+
+	//Half vector between view and light, an exact square root: smooth surfaces make the normal distribution very sensitive to it
+	__m256 hx = _mm256_add_ps(vx, lx), hy = _mm256_add_ps(vy, ly), hz = _mm256_add_ps(vz, lz);
+	const __m256 length = _mm256_sqrt_ps(Dot(hx, hy, hz, hx, hy, hz));
+	hx = _mm256_div_ps(hx, length);
+	hy = _mm256_div_ps(hy, length);
+	hz = _mm256_div_ps(hz, length);
+
+	//Re-usable dot products (clamped to prevent color overflow)
+	const __m256 dotNL = Clamp01(Dot(nx, ny, nz, lx, ly, lz));
+	const __m256 dotNV = Clamp01(Dot(nx, ny, nz, vx, vy, vz));
+	const __m256 dotNH = Clamp01(Dot(nx, ny, nz, hx, hy, hz));
+	const __m256 dotVH = Clamp01(Dot(vx, vy, vz, hx, hy, hz));
+
+	//Normal distribution (Trowbridge-Reitz GGX)
+	const __m256 a = _mm256_mul_ps(roughnessSquared, roughnessSquared);
+	const __m256 denominator = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(dotNH, dotNH), _mm256_sub_ps(a, one)), one);
+	const __m256 normalDistribution = _mm256_mul_ps(_mm256_div_ps(a, _mm256_mul_ps(denominator, denominator)), invPi);
+
+	//Geometry (Smith's function with Schlick-GGX)
+	const __m256 roughnessPlusOne = _mm256_add_ps(roughnessSquared, one);
+	const __m256 k = _mm256_mul_ps(_mm256_mul_ps(roughnessPlusOne, roughnessPlusOne), _mm256_set1_ps(1.f / 8.f));
+	const __m256 oneMinusK = _mm256_sub_ps(one, k);
+	const __m256 masking = _mm256_div_ps(dotNV, _mm256_add_ps(_mm256_mul_ps(dotNV, oneMinusK), k));
+	const __m256 shadowing = _mm256_div_ps(dotNL, _mm256_add_ps(_mm256_mul_ps(dotNL, oneMinusK), k));
+
+	//D * G / 4 * dotNV * dotNL, the same for every channel
+	const __m256 specularFactor = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(normalDistribution, _mm256_mul_ps(masking, shadowing)), _mm256_set1_ps(0.25f)), _mm256_mul_ps(dotNV, dotNL));
+
+	//Fresnel (Schlick), (1 - dotVH)^5 is just multiplies
+	const __m256 oneMinusVH = _mm256_sub_ps(one, dotVH);
+	const __m256 oneMinusVH2 = _mm256_mul_ps(oneMinusVH, oneMinusVH);
+	const __m256 fresnelFactor = _mm256_mul_ps(_mm256_mul_ps(oneMinusVH2, oneMinusVH2), oneMinusVH);
+
+	ShadeChannelAVX2(packet.AlbedoR, packet.R, isMetal, fresnelFactor, specularFactor);
+	ShadeChannelAVX2(packet.AlbedoG, packet.G, isMetal, fresnelFactor, specularFactor);
+	ShadeChannelAVX2(packet.AlbedoB, packet.B, isMetal, fresnelFactor, specularFactor);
+}
+
+//========SELF-CHECK========
+#if defined(DEBUG) || defined(_DEBUG)
+/* Unit length direction, normal distributed components give an even spread over the sphere */
+static void RandomDirection(std::mt19937& random, float& x, float& y, float& z)
+{
+	std::normal_distribution<float> distribution{};
+	x = distribution(random);
+	y = distribution(random);
+	z = distribution(random);
+	const float length = std::sqrt(x * x + y * y + z * z);
+	x /= length;
+	y /= length;
+	z /= length;
+}
+
+/* Largest error of a channel relative to the reference, the reference is clamped to 1e-3 so values that round to black anyway don't count */
+static float MaxRelativeError(const float* pReference, const float* pResult)
+{
+	float maxError = 0.f;
+	for (int32_t lane = 0; lane < BRDF_PACKET_WIDTH; ++lane)
+		maxError = std::max(maxError, std::abs(pResult[lane] - pReference[lane]) / std::max(std::abs(pReference[lane]), 1e-3f));
+	return maxError;
+}
+
+/* Compares the kernels with the scalar reference on random packets (shininess 1 to 128, the roughness range of the materials)
+	and reports the kernels that are further off than the errors documented in BRDFKernels.h */
+static bool MatchesScalarReference(const BRDFKernels& kernels, const char* pName)
+{
+	const float maxPhongError = 1.2e-5f;
+	const float maxCookTorranceError = 1e-4f; //Float rounding only, but GGX of smooth surfaces amplifies it (measured 3.7e-5)
+	std::mt19937 random{ 1 };
+	std::uniform_real_distribution<float> distribution{ 0.f, 1.f };
+	float phongError = 0.f;
+	float cookTorranceError = 0.f;
+	for (int32_t i = 0; i < 4096; ++i)
+	{
+		BRDFPacket reference{};
+		for (int32_t lane = 0; lane < BRDF_PACKET_WIDTH; ++lane)
+		{
+			RandomDirection(random, reference.NormalX[lane], reference.NormalY[lane], reference.NormalZ[lane]);
+			RandomDirection(random, reference.ViewX[lane], reference.ViewY[lane], reference.ViewZ[lane]);
+			RandomDirection(random, reference.LightX[lane], reference.LightY[lane], reference.LightZ[lane]);
+			reference.SpecularReflectance[lane] = distribution(random);
+			reference.Shininess[lane] = 1.f + distribution(random) * 127.f;
+			reference.AlbedoR[lane] = distribution(random);
+			reference.AlbedoG[lane] = distribution(random);
+			reference.AlbedoB[lane] = distribution(random);
+			reference.Roughness[lane] = 0.1f + distribution(random) * 0.9f;
+			reference.Metalness[lane] = (distribution(random) > 0.5f) ? 1.f : 0.f;
+		}
+
+		BRDFPacket result = reference;
+		PhongScalar(reference);
+		kernels.Phong(result);
+		phongError = std::max(phongError, MaxRelativeError(reference.R, result.R));
+
+		LambertCookTorranceScalar(reference);
+		kernels.LambertCookTorrance(result);
+		cookTorranceError = std::max({ cookTorranceError, MaxRelativeError(reference.R, result.R),
+			MaxRelativeError(reference.G, result.G), MaxRelativeError(reference.B, result.B) });
+	}
+
+	const bool isPhongMatching = phongError <= maxPhongError;
+	const bool isCookTorranceMatching = cookTorranceError <= maxCookTorranceError;
+	if (!isPhongMatching)
+		std::cout << "ERROR: " << pName << " Phong is " << phongError << " off the scalar reference, more than " << maxPhongError << std::endl;
+	if (!isCookTorranceMatching)
+		std::cout << "ERROR: " << pName << " Cook-Torrance is " << cookTorranceError << " off the scalar reference, more than " << maxCookTorranceError << std::endl;
+	return isPhongMatching && isCookTorranceMatching;
+}
+#endif
+
+//========DISPATCH========
+const BRDFKernels& GetBRDFKernels(ERasterKernel kernel)
+{
+	static const BRDFKernels scalarKernels{ &PhongScalar, &LambertCookTorranceScalar };
+	static const BRDFKernels avx2Kernels{ &PhongAVX2, &LambertCookTorranceAVX2 };
+	if (kernel != ERasterKernel::AVX2)
+		return scalarKernels;
+
+#if defined(DEBUG) || defined(_DEBUG)
+	static const bool isAVX2Matching = MatchesScalarReference(avx2Kernels, "AVX2");
+	assert(isAVX2Matching && "ERROR: AVX2 BRDF kernels don't match the scalar reference!");
+#endif
+	return avx2Kernels;
+}
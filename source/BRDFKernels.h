@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include "RasterKernels.h"
+
+/* Amount of pixels the BRDF kernels evaluate at once, matches a row of a raster block */
+static const int32_t BRDF_PACKET_WIDTH = RASTER_BLOCK_WIDTH;
+
+/* Inputs and outputs of a packet of pixels (structure of arrays, a lane per pixel) for the BRDF kernels
+	Lanes that aren't in use can hold anything, their results are simply ignored */
+struct BRDFPacket
+{
+	//Input, all directions normalized
+	float NormalX[BRDF_PACKET_WIDTH] = {};
+	float NormalY[BRDF_PACKET_WIDTH] = {};
+	float NormalZ[BRDF_PACKET_WIDTH] = {};
+	float ViewX[BRDF_PACKET_WIDTH] = {};  //Inverse view direction
+	float ViewY[BRDF_PACKET_WIDTH] = {};
+	float ViewZ[BRDF_PACKET_WIDTH] = {};
+	float LightX[BRDF_PACKET_WIDTH] = {}; //Direction towards the light
+	float LightY[BRDF_PACKET_WIDTH] = {};
+	float LightZ[BRDF_PACKET_WIDTH] = {};
+
+	//Phong
+	float SpecularReflectance[BRDF_PACKET_WIDTH] = {};
+	float Shininess[BRDF_PACKET_WIDTH] = {};
+
+	//Lambert Cook-Torrance
+	float AlbedoR[BRDF_PACKET_WIDTH] = {};
+	float AlbedoG[BRDF_PACKET_WIDTH] = {};
+	float AlbedoB[BRDF_PACKET_WIDTH] = {};
+	float Roughness[BRDF_PACKET_WIDTH] = {};
+	float Metalness[BRDF_PACKET_WIDTH] = {}; //0 or 1
+
+	//Output
+	float R[BRDF_PACKET_WIDTH] = {};
+	float G[BRDF_PACKET_WIDTH] = {};
+	float B[BRDF_PACKET_WIDTH] = {};
+};
+
+/* Evaluates a BRDF for every lane of the packet and stores the result in R, G and B */
+using BRDFPacketFunction = void(*)(BRDFPacket& packet);
+
+/* BRDF kernels written for a single instruction set */
+struct BRDFKernels
+{
+	BRDFPacketFunction Phong = nullptr;               //Same as BRDF::Phong, grey result
+	BRDFPacketFunction LambertCookTorrance = nullptr; //Same as BRDF::LambertCookTorrance
+};
+
+/* Returns the BRDF kernels of the given instruction set, the scalar ones call the BRDF class per lane and serve as reference
+	There are no SSE4 BRDF kernels, those fall back to scalar
+	- AVX2 Phong approximates pow with exp2/log2 polynomials, within 1.2e-5 relative error of powf for exponents up to 128
+	- AVX2 Cook-Torrance has no approximations (integer powers are multiplies), it only differs from the reference by float rounding
+	Both are far below the 1/255 steps of the 8-bit backbuffer */
+const BRDFKernels& GetBRDFKernels(ERasterKernel kernel);
@@ -0,0 +1,140 @@
+/* Microbenchmark of the texel layouts of the software rasterizer (see Texture::TileMipChain), not part of the build
+	Samples a 2048x2048 RGBA8 level bilinearly along UV walks with a random rotation and offset, in the pixel order of the rasterizer
+	(64x64 tiles, 8x8 blocks, rows of 8 pixels), for the row by row layout and the block layouts:
+	- RowMajor: index = x + y * width
+	- Morton4: 4x4 blocks, Morton order computed per fetch
+	- Table8: 8x8 blocks, Morton order through per level offset tables (what Texture uses)
+	Scale is the amount of texels a pixel step covers, 1 is magnification-free sampling of the right mip level,
+	2 is the worst case of trilinear filtering before the next level takes over
+
+	Self-contained, build and run it on its own with optimizations:
+		cl /O2 /EHsc /std:c++14 TextureLayoutBenchmark.cpp && TextureLayoutBenchmark.exe
+		g++ -O2 -std=c++14 TextureLayoutBenchmark.cpp -o TextureLayoutBenchmark && ./TextureLayoutBenchmark */
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+static const int TEXTURE_SIZE = 2048; //Power of 2, wrapping is a mask
+static const int SCREEN_WIDTH = 1280;
+static const int SCREEN_HEIGHT = 768;
+static const int TILE_SIZE = 64;
+static const int BLOCK_SIZE = 8;
+static const int NUM_WALKS = 32;
+static const int NUM_RUNS = 3; //Best of, the first run also warms up the caches
+
+/* Spreads the bits of the value apart, a zero bit between every 2 bits of the value */
+static uint32_t SpreadBits(uint32_t value)
+{
+	uint32_t result = 0;
+	for (uint32_t bit = 0; (value >> bit) != 0; ++bit)
+		result |= ((value >> bit) & 1) << (2 * bit);
+	return result;
+}
+
+struct RowMajorLayout
+{
+	const char* Name = "RowMajor";
+	size_t operator()(int x, int y) const { return size_t(y) * TEXTURE_SIZE + size_t(x); }
+};
+
+struct Morton4Layout
+{
+	const char* Name = "Morton4";
+	size_t operator()(int x, int y) const
+	{
+		const size_t block = size_t(y >> 2) * (TEXTURE_SIZE / 4) + size_t(x >> 2);
+		const size_t texel = size_t((x & 1) | ((y & 1) << 1) | ((x & 2) << 1) | ((y & 2) << 2));
+		return block * 16 + texel;
+	}
+};
+
+/* Same tables as Texture::TileMipChain */
+struct Table8Layout
+{
+	const char* Name = "Table8";
+	std::vector<uint32_t> OffsetsX;
+	std::vector<uint32_t> OffsetsY;
+
+	Table8Layout()
+		: OffsetsX(TEXTURE_SIZE)
+		, OffsetsY(TEXTURE_SIZE)
+	{
+		const uint32_t blockArea = BLOCK_SIZE * BLOCK_SIZE;
+		const uint32_t blocksX = TEXTURE_SIZE / BLOCK_SIZE;
+		for (int i = 0; i < TEXTURE_SIZE; ++i)
+		{
+			OffsetsX[i] = uint32_t(i / BLOCK_SIZE) * blockArea + SpreadBits(uint32_t(i % BLOCK_SIZE));
+			OffsetsY[i] = uint32_t(i / BLOCK_SIZE) * blocksX * blockArea + (SpreadBits(uint32_t(i % BLOCK_SIZE)) << 1);
+		}
+	}
+
+	size_t operator()(int x, int y) const { return size_t(OffsetsX[x]) + size_t(OffsetsY[y]); }
+};
+
+/* Returns the milliseconds of the fastest run, the sum of the fetched texels goes into the checksum so nothing gets optimized away */
+template<typename Layout>
+static double Run(const std::vector<uint32_t>& texels, const Layout& layout, float scale, uint64_t& checksum)
+{
+	static const int mask = TEXTURE_SIZE - 1;
+	double bestMilliseconds = 1e30;
+	for (int run = 0; run < NUM_RUNS; ++run)
+	{
+		std::mt19937 random(1); //Same walks for every layout
+		std::uniform_real_distribution<float> distribution(0.f, 1.f);
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (int walk = 0; walk < NUM_WALKS; ++walk)
+		{
+			const float angle = distribution(random) * 6.2831853f;
+			const float cosScaled = cosf(angle) * scale;
+			const float sinScaled = sinf(angle) * scale;
+			const float offsetX = distribution(random) * TEXTURE_SIZE;
+			const float offsetY = distribution(random) * TEXTURE_SIZE;
+
+			for (int tileY = 0; tileY < SCREEN_HEIGHT; tileY += TILE_SIZE)
+			for (int tileX = 0; tileX < SCREEN_WIDTH; tileX += TILE_SIZE)
+			for (int blockY = tileY; blockY < tileY + TILE_SIZE; blockY += BLOCK_SIZE)
+			for (int blockX = tileX; blockX < tileX + TILE_SIZE; blockX += BLOCK_SIZE)
+			for (int y = blockY; y < blockY + BLOCK_SIZE; ++y)
+			for (int x = blockX; x < blockX + BLOCK_SIZE; ++x)
+			{
+				const float u = x * cosScaled - y * sinScaled + offsetX;
+				const float v = x * sinScaled + y * cosScaled + offsetY;
+				const int x0 = int(u) & mask;
+				const int y0 = int(v) & mask;
+				const int x1 = (x0 + 1) & mask;
+				const int y1 = (y0 + 1) & mask;
+				checksum += texels[layout(x0, y0)] + texels[layout(x1, y0)] + texels[layout(x0, y1)] + texels[layout(x1, y1)];
+			}
+		}
+		const std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		bestMilliseconds = std::min(bestMilliseconds, elapsed.count());
+	}
+	return bestMilliseconds;
+}
+
+int main()
+{
+	//The values don't matter for the timing, only the addresses do
+	std::vector<uint32_t> texels(size_t(TEXTURE_SIZE) * TEXTURE_SIZE);
+	for (size_t i = 0; i < texels.size(); ++i)
+		texels[i] = uint32_t(i * 2654435761u);
+
+	const RowMajorLayout rowMajor{};
+	const Morton4Layout morton4{};
+	const Table8Layout table8{};
+	uint64_t checksum = 0;
+	const float scales[] = { 1.f, 2.f };
+	for (float scale : scales)
+	{
+		printf("%.0f texel(s) per pixel:", scale);
+		printf("  %s %.1f ms", rowMajor.Name, Run(texels, rowMajor, scale, checksum));
+		printf("  %s %.1f ms", morton4.Name, Run(texels, morton4, scale, checksum));
+		printf("  %s %.1f ms\n", table8.Name, Run(texels, table8, scale, checksum));
+	}
+	printf("checksum %llu\n", static_cast<unsigned long long>(checksum));
+	return 0;
+}
@@ -116,6 +116,16 @@ void CustomScene::UpdateKeyInputs()
 			}
 		}
 	}
+	//------------------- RASTER THREADS -------------------
+	else if (input.IsPressed(EKeyboardInput::ToggleRasterThreads))
+	{
+		ToggleRasterThreadCount();
+	}
+	//------------------- SHADING MODE -------------------
+	else if (input.IsPressed(EKeyboardInput::ToggleVisibilityBuffer))
+	{
+		ToggleVisibilityBuffer();
+	}
 	//------------------- DISPLAY INFO -------------------
 	else if (input.IsPressed(EKeyboardInput::DisplayKeyBindInfo))
 	{
@@ -140,6 +150,7 @@ void CustomScene::InitializeMaterials()
 	pMat->SetNormalTexture("./Resources/daebot/normal.png", pDevice);
 	pMat->SetRoughnessTexture("./Resources/daebot/roughness.png", pDevice);
 	pMat->SetMetalnessTexture("./Resources/daebot/metallic.png", pDevice);
+	pMat->PackScalarTextures();
 	AddMaterial(pMat);
 }
 
@@ -186,6 +197,10 @@ void CustomScene::DisplayKeyBindInfo()
 		"+--------------------------------------+-----+\n" <<
 		"| Toggle CullModes (SRAS and DX)       |  C  |\n" <<
 		"+--------------------------------------+-----+\n" <<
+		"| Toggle Raster Threads (SRAS)         |  M  |\n" <<
+		"+--------------------------------------+-----+\n" <<
+		"| Toggle Visibility Buffer (SRAS)      |  V  |\n" <<
+		"+--------------------------------------+-----+\n" <<
 		"| Toggle Mesh Rotation                 |SPACE|\n" <<
 		"+--------------------------------------+-----+\n" <<
 		"| Previous Scene                       |  F1 |\n" <<
@@ -109,7 +109,7 @@ namespace Elite
 				data[0][2] * revS, data[1][2] * revS, data[2][2] * revS);
 		}
 
-		inline Matrix<3, 3, T> operator*(const Matrix<3, 3, T>& rm)
+		inline Matrix<3, 3, T> operator*(const Matrix<3, 3, T>& rm) const
 		{
 			const Matrix<3, 3, T>& lm = (*this);
 			return Matrix<3, 3, T>(
@@ -126,7 +126,7 @@ namespace Elite
 				lm(2, 0) * rm(0, 2) + lm(2, 1) * rm(1, 2) + lm(2, 2) * rm(2, 2));
 		}
 
-		inline Vector<3, T> operator*(const Vector<3, T>& v)
+		inline Vector<3, T> operator*(const Vector<3, T>& v) const
 		{
 			const Matrix<3, 3, T>& m = (*this);
 			return Vector<3, T>(
@@ -10,7 +10,10 @@
 #include "TriangleMesh.h"
 #include "Triangle.h"
 #include "DirectionalLight.h"
-#include "BRDF.h"
+#include "ThreadPool.h"
+#include "FrameArena.h"
+#include "AllocationCounter.h"
+#include "Effect.h"
 
 using Topology = EPrimitiveTopology;
 using namespace Elite;
@@ -23,6 +26,18 @@ Elite::Renderer::Renderer(SDL_Window * pWindow)
 	, m_pBackBuffer(nullptr)
 	, m_pBackBufferPixels(nullptr)
 	, m_DepthBuffer()
+	, m_ClearColor()
+	, m_FrameStats()
+	, m_VisibilityBuffer()
+	, m_TransformedVertices()
+	, m_pClipArena(nullptr)
+	, m_NumTilesX()
+	, m_NumTilesY()
+	, m_Tiles()
+	, m_BinnedTriangles()
+	, m_pThreadPool(nullptr)
+	, m_RasterKernel(ERasterKernel::Scalar)
+	, m_pRasterBlock(nullptr)
 	, m_pDevice(nullptr)
 	, m_pDeviceContext()
 	, m_pDXGIFactory()
@@ -43,6 +58,31 @@ Elite::Renderer::Renderer(SDL_Window * pWindow)
 	m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
 	m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
 	m_DepthBuffer = std::vector<float>(size_t(m_Width * m_Height), FLT_MAX);
+	m_VisibilityBuffer = std::vector<VisibilitySample>(size_t(m_Width * m_Height));
+	m_ClearColor = SDL_MapRGB(m_pBackBuffer->format, static_cast<uint8_t>(50), static_cast<uint8_t>(50), static_cast<uint8_t>(50));
+
+	//Divide the screen into tiles, tiles on the right and bottom edge can be smaller
+	m_NumTilesX = (m_Width + TILE_SIZE - 1) / TILE_SIZE;
+	m_NumTilesY = (m_Height + TILE_SIZE - 1) / TILE_SIZE;
+	m_Tiles.resize(size_t(m_NumTilesX * m_NumTilesY));
+	for (uint32_t ty = 0; ty < m_NumTilesY; ++ty)
+	{
+		for (uint32_t tx = 0; tx < m_NumTilesX; ++tx)
+		{
+			RasterTile& tile = m_Tiles[tx + (ty * m_NumTilesX)];
+			tile.MinX = tx * TILE_SIZE;
+			tile.MinY = ty * TILE_SIZE;
+			tile.MaxX = std::min(tile.MinX + TILE_SIZE, m_Width);
+			tile.MaxY = std::min(tile.MinY + TILE_SIZE, m_Height);
+		}
+	}
+	m_pThreadPool = new ThreadPool();
+	m_pClipArena = new FrameArena(size_t(1) << 20);
+
+	//Pick the widest pixel block kernel this CPU supports
+	m_RasterKernel = GetBestRasterKernel();
+	m_pRasterBlock = GetRasterBlockFunction(m_RasterKernel);
+	std::cout << "Raster Kernel - " << GetRasterKernelName(m_RasterKernel) << "\n";
 
 	//Initialize DirectX pipeline
 	if (SUCCEEDED(InitializeDirectX()))
@@ -54,6 +94,8 @@ Elite::Renderer::Renderer(SDL_Window * pWindow)
 
 Elite::Renderer::~Renderer()
 {
+	delete m_pThreadPool;
+	delete m_pClipArena;
 	m_pRenderTargetView->Release();
 	m_pRenderTargetBuffer->Release();
 	m_pDepthStencilView->Release();
@@ -193,34 +235,75 @@ HRESULT Elite::Renderer::InitializeDirectX()
 	return result;
 }
 
+/* Filtering of the SRAS closest to the sampler state the DX side uses, there's no anisotropic filtering in software */
+static ETextureFilter GetTextureFilter(ESamplerState sampleState)
+{
+	switch (sampleState)
+	{
+	case ESamplerState::Point:
+		return ETextureFilter::Point;
+	case ESamplerState::Linear:
+	case ESamplerState::Anisotropic:
+	default:
+		return ETextureFilter::Trilinear;
+	}
+}
+
 void Elite::Renderer::RenderSRAS(const std::vector<TriangleMesh*>& pTriangleMeshes, const MaterialManager& materials, const LightManager& lights, Camera* pCamera, const KeyBindInfo& keyBindInfo)
 {
 	SDL_LockSurface(m_pBackBuffer);
 
-	//Clear depth and color buffer
-	for (uint32_t r = 0; r < m_Height; ++r)
+	//Match the requested amount of raster threads
+	m_pThreadPool->SetThreadCount(keyBindInfo.NumRasterThreads);
+
+	//Free the clipped triangles of the previous frame, from here on the frame shouldn't touch the heap anymore
+	m_pClipArena->Reset();
+	const HeapAllocationScope allocationScope{};
+	const uint64_t numAllocationsAtStart = GetHeapAllocationCount();
+	m_FrameStats = FrameStats{};
+
+	//Clear draws and bins of previous frame
+	m_Draws.clear();
+	m_BinnedTriangles.clear();
+	for (RasterTile& tile : m_Tiles)
 	{
-		for (uint32_t c = 0; c < m_Width; ++c)
-		{
-			m_DepthBuffer[c + (r * m_Width)] = FLT_MAX;
-			m_pBackBufferPixels[c + (r * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-				static_cast<uint8_t>(50),
-				static_cast<uint8_t>(50),
-				static_cast<uint8_t>(50));
-		}
+		tile.TriangleIndices.clear();
+		tile.NumFragmentsRasterized = 0;
+		tile.NumFragmentsShaded = 0;
 	}
 
 	//For every triangle mesh
 	const auto& pLights = lights.GetLights();
+	const FVector2 guardBand = Triangle::GetGuardBand((float)m_Width, (float)m_Height, keyBindInfo);
 	for (TriangleMesh* pTriangleMesh : pTriangleMeshes)
 	{
 		//Check if valid
 		if (!pTriangleMesh->IsValid())
 			continue;
 
+		//Matrices are set up once per mesh
+		const DrawConstants constants = GetDrawConstants(pTriangleMesh, pCamera);
+
+		//Meshes outside of the frustum don't need any of their vertices or triangles processed
+		const EFrustumTest frustumTest = TestFrustum(pTriangleMesh->GetBoundingVolume(), constants, guardBand);
+		if (frustumTest == EFrustumTest::Outside)
+			continue;
+		const bool needsClipping = (frustumTest != EFrustumTest::Inside);
+
+		//Material lookup and the choice of shading function only once per draw, pixels only read the descriptor
+		const Material* pMaterial = materials.GetMaterialByID(pTriangleMesh->GetMaterialID());
+		const uint32_t drawIdx = uint32_t(m_Draws.size());
+		DrawShading draw{};
+		draw.Descriptor = pMaterial ? pMaterial->GetShadingDescriptor() : ShadingDescriptor{};
+		draw.Descriptor.Sampler.Filter = GetTextureFilter(pTriangleMesh->GetSampleState());
+		draw.pShadingFunction = GetShadingFunction(draw.Descriptor, keyBindInfo);
+		m_Draws.push_back(draw);
+
+		//Vertex processing, every vertex only gets transformed once
+		TransformMeshVertices(pTriangleMesh, constants);
+
 		//Gather data from triangle mesh
 		const auto& indexBuffer = pTriangleMesh->GetIndexBuffer();
-		const auto& vertices = pTriangleMesh->GetVertexBuffer();
 		Topology topology = pTriangleMesh->GetPrimitiveTopology();
 		size_t incrementValue = (topology == Topology::TriangleList) ? 3 : 1;
 		bool swapOnOdd = (topology == Topology::TriangleList) ? false : true;
@@ -228,48 +311,65 @@ void Elite::Renderer::RenderSRAS(const std::vector<TriangleMesh*>& pTriangleMesh
 		//Start looping over all indices 
 		for (size_t i = 0; i < indexBuffer.size() - 2; i += incrementValue)
 		{
-			//Create triangle
+			//Assemble triangle from the vertex cache
 			Triangle t = (swapOnOdd && i & 1)
 				? Triangle //Swap last 2 indices on odd triangle in strip
 				(
-					Vertex_Input{ vertices[indexBuffer[i]] },
-					Vertex_Input{ vertices[indexBuffer[i + 2]] },
-					Vertex_Input{ vertices[indexBuffer[i + 1]] }
+					m_TransformedVertices[indexBuffer[i]],
+					m_TransformedVertices[indexBuffer[i + 2]],
+					m_TransformedVertices[indexBuffer[i + 1]],
+					pTriangleMesh->GetMaterialID()
 				)
 				: Triangle //Else continue making triangles from a list or even triangle in strip
 				(
-					Vertex_Input{ vertices[indexBuffer[i]] },
-					Vertex_Input{ vertices[indexBuffer[i + 1]] },
-					Vertex_Input{ vertices[indexBuffer[i + 2]] }
+					m_TransformedVertices[indexBuffer[i]],
+					m_TransformedVertices[indexBuffer[i + 1]],
+					m_TransformedVertices[indexBuffer[i + 2]],
+					pTriangleMesh->GetMaterialID()
 			);
 
-			//Transform triangle
-			t.TransformVertices((float)m_Width, (float)m_Height, pTriangleMesh->GetWorldMatrix(), pCamera, keyBindInfo, true);
+			//Set cullmode for upcoming setup, triangles made by clipping take it over
+			t.SetCullMode(pTriangleMesh->GetCullMode());
+
+			//Cull/clip and project triangle to the screen
+			t.ProjectToScreen((float)m_Width, (float)m_Height, keyBindInfo, *m_pClipArena, needsClipping);
 
 			//If triangle already isn't valid, continue
 			if (!t.IsInsideFrustum())
 				continue;
 
-			//Set cullmode for upcoming hit check
-			t.SetCullMode(pTriangleMesh->GetCullMode());
-
-			//If triangle is clipped, loop over the pixels surrounding that triangle and render
+			//If triangle is clipped, bin the triangles it was clipped into
 			if (t.IsTriangleClipped())
 			{
-				auto& clippedTriangles = t.GetClippedTriangles();
-				for (const Triangle& clippedTriangle : clippedTriangles)
+				const Triangle* pClippedTriangles = t.GetClippedTriangles();
+				for (uint32_t clippedIdx = 0; clippedIdx < t.GetNumClippedTriangles(); ++clippedIdx)
 				{
-					PixelLoop(clippedTriangle, materials, pLights, keyBindInfo);
+					BinTriangle(pClippedTriangles[clippedIdx], drawIdx);
 				}
 			}
-			//Else loop over the pixels surrounding the current triangle and render
+			//Else bin the current triangle
 			else
 			{
-				PixelLoop(t, materials, pLights, keyBindInfo);
+				BinTriangle(t, drawIdx);
 			}
 		}
 	}
 
+	//Every tile clears and renders its own pixels, so tiles can be processed in parallel without locking
+	m_pThreadPool->ParallelFor(uint32_t(m_Tiles.size()), [&](uint32_t tileIdx)
+		{
+			const HeapAllocationScope allocationScope{}; //Raster workers count as well
+			RenderTile(m_Tiles[tileIdx], pLights, keyBindInfo);
+		});
+
+	//Gather the counters of all tiles
+	for (const RasterTile& tile : m_Tiles)
+	{
+		m_FrameStats.NumFragmentsRasterized += tile.NumFragmentsRasterized;
+		m_FrameStats.NumFragmentsShaded += tile.NumFragmentsShaded;
+	}
+	m_FrameStats.NumHeapAllocations = GetHeapAllocationCount() - numAllocationsAtStart;
+
 	SDL_UnlockSurface(m_pBackBuffer);
 	SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
 	SDL_UpdateWindowSurface(m_pWindow);
@@ -301,181 +401,350 @@ void Elite::Renderer::RenderDX(const std::vector<TriangleMesh*>& pTriangleMeshes
 	m_pSwapChain->Present(0, 0);
 }
 
-void Elite::Renderer::PixelLoop(const Triangle& triangle, const MaterialManager& materialManager, const std::vector<Light*>& pLights, const KeyBindInfo& keyBindInfo)
+DrawConstants Elite::Renderer::GetDrawConstants(const TriangleMesh* pTriangleMesh, const Camera* pCamera) const
 {
-	//Adjust bounding box
-	BoundingBox boundingBox{};
-	triangle.AdjustBoundingBox(boundingBox, (float)m_Width, (float)m_Height);
+	DrawConstants constants{};
 
-	//Loop over all pixels
-	for (uint32_t r = uint32_t(boundingBox.TopLeft.y); r < uint32_t(boundingBox.BottomRight.y); ++r)
+	//Since the vertices are parsed for DirectX (LHS) we have to revert it to work for our SRAS in RHS
+	constants.InvertToRHS = true;
+	constants.World = pTriangleMesh->GetWorldMatrix();
+	constants.Normal = FMatrix3(constants.World);
+	constants.CameraPosition = pCamera->GetPosition();
+
+	//Model to WorldSpace -> to ViewSpace -> to Projection Space
+	constants.WorldViewProjection = pCamera->GetProjMatrix() * Inverse(pCamera->GetLookAtMatrix()) * ((constants.InvertToRHS) ? Inverse(constants.World) : constants.World);
+	return constants;
+}
+
+EFrustumTest Elite::Renderer::TestFrustum(const BoundingVolume& volume, const DrawConstants& constants, const FVector2& guardBand) const
+{
+	//The vertices get their z inverted before being transformed, so the volume has to be as well
+	FPoint3 min = volume.Min;
+	FPoint3 max = volume.Max;
+	FPoint3 center = volume.Center;
+	if (constants.InvertToRHS)
 	{
-		for (uint32_t c = uint32_t(boundingBox.TopLeft.x); c < uint32_t(boundingBox.BottomRight.x); ++c)
-		{
-			//Create pixel point and empty hitrecord to store the information of the hit
-			FPoint2 pixel{ float(c), float(r) };
-			HitRecord hitRecord{};
+		min.z = -volume.Max.z;
+		max.z = -volume.Min.z;
+		center.z = -volume.Center.z;
+	}
 
-			if (triangle.Hit(pixel, hitRecord))
-			{
-				if (hitRecord.InterpolatedZ > 0.f && hitRecord.InterpolatedZ < 1.f && hitRecord.InterpolatedZ <= m_DepthBuffer[c + (r * m_Width)])
-				{
-					//Store closer depth value
-					m_DepthBuffer[c + (r * m_Width)] = hitRecord.InterpolatedZ;
+	//Object space planes straight from the rows of the matrix (Gribb-Hartmann), same signs as the clipping space planes of the triangles
+	const FMatrix4& m = constants.WorldViewProjection;
+	const FVector4 rows[4] =
+	{
+		FVector4{ m(0, 0), m(0, 1), m(0, 2), m(0, 3) },
+		FVector4{ m(1, 0), m(1, 1), m(1, 2), m(1, 3) },
+		FVector4{ m(2, 0), m(2, 1), m(2, 2), m(2, 3) },
+		FVector4{ m(3, 0), m(3, 1), m(3, 2), m(3, 3) }
+	};
+	const uint32_t numPlanes = 6;
+	const FVector4 frustumPlanes[numPlanes] =
+	{
+		rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2]
+	};
+	//Triangles only get clipped against the guard band (if any), the far plane is then left to the depth test
+	const bool isFarPlaneClipped = (guardBand.x <= 1.f && guardBand.y <= 1.f);
+	const FVector4 clipPlanes[numPlanes] =
+	{
+		rows[3] * guardBand.x + rows[0], rows[3] * guardBand.x - rows[0], rows[3] * guardBand.y + rows[1], rows[3] * guardBand.y - rows[1], rows[2], rows[3] - rows[2]
+	};
 
-					//You can start shading this pixel now 
-					RGBColor finalColor = PixelShading(hitRecord, materialManager, pLights, keyBindInfo);
+	//Sphere first, it only needs a single dot product per plane
+	bool isInside = true;
+	for (uint32_t p = 0; p < numPlanes; ++p)
+	{
+		const FVector4& plane = frustumPlanes[p];
+		const FVector3 normal{ plane.x, plane.y, plane.z };
+		if (Dot(normal, FVector3(center)) + plane.w < -volume.Radius * Magnitude(normal))
+			return EFrustumTest::Outside;
+
+		const FVector4& clipPlane = clipPlanes[p];
+		const FVector3 clipNormal{ clipPlane.x, clipPlane.y, clipPlane.z };
+		if ((p != numPlanes - 1 || isFarPlaneClipped) && Dot(clipNormal, FVector3(center)) + clipPlane.w < volume.Radius * Magnitude(clipNormal))
+			isInside = false;
+	}
+	if (isInside)
+		return EFrustumTest::Inside;
 
-					//Fill the pixels
-					m_pBackBufferPixels[c + (r * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-						static_cast<uint8_t>(finalColor.r * 255.f),
-						static_cast<uint8_t>(finalColor.g * 255.f),
-						static_cast<uint8_t>(finalColor.b * 255.f));
-				}
-			}
+	//Box is tighter: it's outside when its corner furthest along the normal is, inside when its corner furthest against the normal is
+	isInside = true;
+	for (uint32_t p = 0; p < numPlanes; ++p)
+	{
+		const FVector4& plane = frustumPlanes[p];
+		const FVector3 positiveCorner{ (plane.x >= 0.f) ? max.x : min.x, (plane.y >= 0.f) ? max.y : min.y, (plane.z >= 0.f) ? max.z : min.z };
+		if (plane.x * positiveCorner.x + plane.y * positiveCorner.y + plane.z * positiveCorner.z + plane.w < 0.f)
+			return EFrustumTest::Outside;
+
+		const FVector4& clipPlane = clipPlanes[p];
+		const FVector3 negativeCorner{ (clipPlane.x >= 0.f) ? min.x : max.x, (clipPlane.y >= 0.f) ? min.y : max.y, (clipPlane.z >= 0.f) ? min.z : max.z };
+		if ((p != numPlanes - 1 || isFarPlaneClipped) && clipPlane.x * negativeCorner.x + clipPlane.y * negativeCorner.y + clipPlane.z * negativeCorner.z + clipPlane.w < 0.f)
+			isInside = false;
+	}
+	return isInside ? EFrustumTest::Inside : EFrustumTest::Intersecting;
+}
+
+void Elite::Renderer::TransformMeshVertices(const TriangleMesh* pTriangleMesh, const DrawConstants& constants)
+{
+	const auto& vertices = pTriangleMesh->GetVertexBuffer();
+	m_TransformedVertices.resize(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		Triangle::TransformVertex(vertices[i], m_TransformedVertices[i], constants);
+	}
+}
+
+void Elite::Renderer::BinTriangle(const Triangle& triangle, uint32_t drawIdx)
+{
+	//Edge functions, attribute planes and cullmode are only computed once per triangle, culled triangles never reach the pixel loop
+	TriangleSetup setup{};
+	const ESetupResult result = triangle.Setup(setup, (float)m_Width, (float)m_Height);
+	if (result == ESetupResult::Culled)
+		++m_FrameStats.NumTrianglesCulled;
+	if (result != ESetupResult::Visible)
+		return;
+	++m_FrameStats.NumTrianglesBinned;
+	setup.DrawIdx = drawIdx;
+
+	//Add triangle to all tiles overlapping its bounding box
+	uint32_t triangleIdx = uint32_t(m_BinnedTriangles.size());
+	m_BinnedTriangles.push_back(setup);
+
+	uint32_t firstTileX = uint32_t(setup.MinX) / TILE_SIZE;
+	uint32_t firstTileY = uint32_t(setup.MinY) / TILE_SIZE;
+	uint32_t lastTileX = uint32_t(setup.MaxX - 1) / TILE_SIZE;
+	uint32_t lastTileY = uint32_t(setup.MaxY - 1) / TILE_SIZE;
+	for (uint32_t ty = firstTileY; ty <= lastTileY; ++ty)
+	{
+		for (uint32_t tx = firstTileX; tx <= lastTileX; ++tx)
+		{
+			m_Tiles[tx + (ty * m_NumTilesX)].TriangleIndices.push_back(triangleIdx);
 		}
 	}
 }
 
-Elite::RGBColor Elite::Renderer::PixelShading(const HitRecord& hitRecord, const MaterialManager& materialManager, const std::vector<Light*>& pLights, const KeyBindInfo& keyBindInfo)
+void Elite::Renderer::RenderTile(RasterTile& tile, const std::vector<Light*>& pLights, const KeyBindInfo& keyBindInfo)
 {
-	//Coloring in the returned result
-	RGBColor finalColor{};
-	if (keyBindInfo.UseDepthBufferAsColor)
+	//Clear depth and color buffer
+	for (uint32_t r = tile.MinY; r < tile.MaxY; ++r)
 	{
-		//Use depth as gradient for color
-		float depthColor = Elite::Remap(hitRecord.InterpolatedZ, 0.985f, 1.f);
-		finalColor = { depthColor, depthColor, depthColor };
+		for (uint32_t c = tile.MinX; c < tile.MaxX; ++c)
+		{
+			m_DepthBuffer[c + (r * m_Width)] = FLT_MAX;
+			m_pBackBufferPixels[c + (r * m_Width)] = m_ClearColor;
+			m_VisibilityBuffer[c + (r * m_Width)].TriangleIdx = INVALID_TRIANGLE;
+		}
 	}
-	else
+
+	//Triangles are stored in submission order, so depth ties resolve exactly like a single-threaded render
+	for (uint32_t triangleIdx : tile.TriangleIndices)
 	{
-		//If not using material, then use the color defined in the triangle
-		if (keyBindInfo.UseMaterial)
+		PixelLoop(triangleIdx, tile, pLights, keyBindInfo);
+	}
+
+	//Deferred: only the fragments that are still visible get shaded
+	if (keyBindInfo.UseVisibilityBuffer)
+		ShadeVisibilityBuffer(tile, pLights);
+}
+
+void Elite::Renderer::ShadeVisibilityBuffer(RasterTile& tile, const std::vector<Light*>& pLights)
+{
+	//Neighbouring visible pixels of the same draw are gathered into packets, so they get shaded together
+	ShadingPacket packet{};
+	uint32_t pixelIndices[BRDF_PACKET_WIDTH] = {};
+	uint32_t numLanes = 0;
+	uint32_t drawIdx = 0;
+	for (uint32_t r = tile.MinY; r < tile.MaxY; ++r)
+	{
+		for (uint32_t c = tile.MinX; c < tile.MaxX; ++c)
 		{
-			//Get sampled texture color from texture matching the triangle
-			Material* pMat = materialManager.GetMaterialByID(hitRecord.MatID);
-			if (!pMat)
-				return RGBColor(0, 0, 0);
-
-			//------ Diffuse ------
-			Elite::RGBColor diffuse{};
-			float diffuseReflectance = pMat->GetDiffuseReflectance();
-			if (pMat->UseDiffuseMap())
-			{
-				diffuse = pMat->GetDiffuseTexture()->Sample(hitRecord.InterpolatedUV) * diffuseReflectance;
-			}
-			else
+			const uint32_t pixelIdx = c + (r * m_Width);
+			const VisibilitySample& sample = m_VisibilityBuffer[pixelIdx];
+			if (sample.TriangleIdx == INVALID_TRIANGLE)
+				continue;
+
+			const TriangleSetup& setup = m_BinnedTriangles[sample.TriangleIdx];
+			if (numLanes == uint32_t(BRDF_PACKET_WIDTH) || (numLanes > 0 && setup.DrawIdx != drawIdx))
 			{
-				diffuse = pMat->GetDiffuseColor() * diffuseReflectance;
+				ShadePacket(packet, m_Draws[drawIdx], pixelIndices, pLights);
+				tile.NumFragmentsShaded += numLanes;
+				packet.LaneMask = 0;
+				numLanes = 0;
 			}
 
-			//------ Normal ------
-			FVector3 newNormal{};
-			if (pMat->UseNormalMap())
-			{
-				//We define our tangent space
-				FVector3 binormal = Cross(hitRecord.InterpolatedTangent, hitRecord.InterpolatedVertexNormal);
-				FMatrix3 localTangentSpace = FMatrix3(hitRecord.InterpolatedTangent, binormal, hitRecord.InterpolatedVertexNormal);
+			InterpolateLane(setup, m_DepthBuffer[pixelIdx], sample.W1, sample.W2, numLanes, packet);
+			pixelIndices[numLanes++] = pixelIdx;
+			drawIdx = setup.DrawIdx;
+		}
+	}
+
+	if (numLanes > 0)
+	{
+		ShadePacket(packet, m_Draws[drawIdx], pixelIndices, pLights);
+		tile.NumFragmentsShaded += numLanes;
+	}
+}
 
-				//Sample normal map
-				Elite::RGBColor normalSample = pMat->GetNormalTexture()->Sample(hitRecord.InterpolatedUV);
+void Elite::Renderer::PixelLoop(uint32_t triangleIdx, RasterTile& tile, const std::vector<Light*>& pLights, const KeyBindInfo& keyBindInfo)
+{
+	const TriangleSetup& setup = m_BinnedTriangles[triangleIdx];
+
+	//Only loop over the pixels of the bounding box this tile owns
+	const int32_t minX = std::max(setup.MinX, int32_t(tile.MinX));
+	const int32_t minY = std::max(setup.MinY, int32_t(tile.MinY));
+	const int32_t maxX = std::min(setup.MaxX, int32_t(tile.MaxX));
+	const int32_t maxY = std::min(setup.MaxY, int32_t(tile.MaxY));
+	if (minX >= maxX || minY >= maxY)
+		return;
 
-				//An RBG Color goes from [0, 255] range, while we will need this in [-1, 1]
-				//Sampled value is already returned in range [0, 1]
-				normalSample = (normalSample * 2.f) - RGBColor(1.f, 1.f, 1.f);
+	//Blocks start on a multiple of the block size, tiles do too so a block never reaches into the tile on its left or top
+	const int32_t blockMinX = minX - (minX % RASTER_BLOCK_WIDTH);
+	const int32_t blockMinY = minY - (minY % RASTER_BLOCK_HEIGHT);
+	RasterBlockSetup blockSetup{};
+	PrepareRasterBlock(setup, blockSetup);
+	RasterBlock block{};
+	float partialDepth[RASTER_BLOCK_WIDTH] = {};
+	ShadingPacket packet{};
+	uint32_t pixelIndices[RASTER_BLOCK_WIDTH] = {};
+	static_assert(RASTER_BLOCK_WIDTH == BRDF_PACKET_WIDTH, "A row of a raster block is shaded as a single packet");
+
+	//Edge functions are linear, so their smallest and largest value over a block always lie on one of its corners
+	int64_t cornerMinOffset[3] = {};
+	int64_t cornerMaxOffset[3] = {};
+	for (int32_t e = 0; e < 3; ++e)
+	{
+		const int64_t toRight = setup.Edges[e].StepX * (RASTER_BLOCK_WIDTH - 1);
+		const int64_t toBottom = setup.Edges[e].StepY * (RASTER_BLOCK_HEIGHT - 1);
+		cornerMinOffset[e] = std::min(toRight, int64_t(0)) + std::min(toBottom, int64_t(0));
+		cornerMaxOffset[e] = std::max(toRight, int64_t(0)) + std::max(toBottom, int64_t(0));
+	}
 
-				//Transform to tangent space
-				newNormal = GetNormalized(localTangentSpace * FVector3(normalSample.r, normalSample.g, normalSample.b));
-			}
-			else
+	//Edge function values at the top left pixel of every block, from there on they're stepped with integer adds
+	int64_t blockStepX[3] = {};
+	int64_t blockStepY[3] = {};
+	int64_t blockRowEdges[3] = {};
+	for (int32_t e = 0; e < 3; ++e)
+	{
+		blockStepX[e] = setup.Edges[e].StepX * RASTER_BLOCK_WIDTH;
+		blockStepY[e] = setup.Edges[e].StepY * RASTER_BLOCK_HEIGHT;
+		blockRowEdges[e] = setup.Edges[e].Evaluate(blockMinX, blockMinY);
+	}
+
+	//Loop over all blocks of 8x8 pixels
+	for (int32_t by = blockMinY; by < maxY; by += RASTER_BLOCK_HEIGHT)
+	{
+		int64_t blockEdges[3] = { blockRowEdges[0], blockRowEdges[1], blockRowEdges[2] };
+		for (int32_t bx = blockMinX; bx < maxX; bx += RASTER_BLOCK_WIDTH)
+		{
+			//Trivial reject when all corners are outside of one edge, trivial accept when all corners are inside of every edge
+			bool isOutside = false;
+			bool isInside = true;
+			for (int32_t e = 0; e < 3; ++e)
 			{
-				//This value is already normalized
-				newNormal = hitRecord.InterpolatedVertexNormal;
+				isOutside |= (blockEdges[e] + cornerMaxOffset[e]) < 0;
+				isInside &= (blockEdges[e] + cornerMinOffset[e]) >= 0;
 			}
 
-			//Data to store information while contributing every light
-			for (Light* pLight : pLights)
+			if (!isOutside)
 			{
-				//------ Irradiance ------
-				Elite::RGBColor irradiance = pLight->GetCalculatedIrradianceColor(newNormal, true);
-
-				//Decide what BRDF to use:
-				Material::MaterialWorkflow workflow{ pMat->GetMaterialWorkflow() };
-				if (workflow == Material::MaterialWorkflow::SpecGloss)
+				//Only the lanes inside [minX, maxX) belong to this triangle and tile
+				uint32_t laneMask = (1u << RASTER_BLOCK_WIDTH) - 1;
+				if (bx < minX)
+					laneMask &= ~((1u << (minX - bx)) - 1);
+				if (bx + RASTER_BLOCK_WIDTH > maxX)
+					laneMask &= (1u << (maxX - bx)) - 1;
+
+				//Partially covered blocks get tested per pixel, a row of the block at a time
+				block.IsFullyCovered = isInside;
+				block.LaneMask = laneMask;
+				const int32_t rowBegin = std::max(by, minY);
+				const int32_t rowEnd = std::min(by + RASTER_BLOCK_HEIGHT, maxY);
+				for (int32_t r = rowBegin; r < rowEnd; ++r)
 				{
-					//------ Phong BRDF ------
-					//------ Specular ------
-					//Color
-					RGBColor specColor{};
-					if (pMat->UseSpecularMap())
-					{
-						specColor = pMat->GetSpecularTexture()->Sample(hitRecord.InterpolatedUV);
-					}
-					else
-					{
-						specColor = pMat->GetSpecularColor();
-					}
+					for (int32_t e = 0; e < 3; ++e)
+						block.Edges[e] = blockEdges[e] + setup.Edges[e].StepY * (r - by);
 
-					//Shininess
-					float shininess = pMat->GetShininess();
-					if (pMat->UseGlossinessMap())
+					//Lanes past maxX can belong to another tile (or lie outside of the screen), so those depth values are never read
+					block.pDepthBuffer = &m_DepthBuffer[bx + (r * m_Width)];
+					if (bx + RASTER_BLOCK_WIDTH > maxX)
 					{
-						shininess *= pMat->GetGlossinessTexture()->Sample(hitRecord.InterpolatedUV).r;
+						for (int32_t lane = 0; lane < maxX - bx; ++lane)
+							partialDepth[lane] = block.pDepthBuffer[lane];
+						block.pDepthBuffer = partialDepth;
 					}
 
-					//Reflectance
-					float specReflectance = pMat->GetSpecularReflectance();
-
-					//Because of lightDir being initialized for a LHS in DX, we have to invert Z to get same effect
-					FVector3 lightDir = pLight->GetDirection(hitRecord, true);
-					RGBColor specularReflect = BRDF::Phong(specReflectance, shininess, -lightDir, hitRecord.ViewDirection, newNormal);
-					Elite::RGBColor phongSpecular = specColor * specularReflect;
+					//Inside-outside and depth test of the whole row at once
+					const uint32_t mask = m_pRasterBlock(blockSetup, block);
+					if (mask == 0)
+						continue;
 
-					//Adding up contribution
-					finalColor += irradiance * (diffuse / float(E_PI)) + phongSpecular;
-					
-				}
-				else if (workflow == Material::MaterialWorkflow::MetalRough)
-				{
-					//------ Lambert Cook-Torrance BRDF ------
-					//Because of lightDir being initialized for a LHS in DX, we have to invert Z to get same effec
-					FVector3 lightDir = pLight->GetDirection(hitRecord, true);
-
-					//------ Roughness ------
-					float roughness = 0.6f;
-					if (pMat->UseRoughnessMap())
+					for (int32_t lane = 0; lane < RASTER_BLOCK_WIDTH; ++lane)
 					{
-						roughness = pMat->GetRoughnessTexture()->Sample(hitRecord.InterpolatedUV).r;
+						if ((mask & (1u << lane)) == 0)
+							continue;
+
+						//Store closer depth value
+						const uint32_t pixelIdx = uint32_t(bx + lane) + (uint32_t(r) * m_Width);
+						m_DepthBuffer[pixelIdx] = block.Depth[lane];
+						++tile.NumFragmentsRasterized;
+
+						//Deferred: only remember which triangle is visible, it gets shaded once all triangles are rasterized
+						if (keyBindInfo.UseVisibilityBuffer)
+						{
+							m_VisibilityBuffer[pixelIdx] = VisibilitySample{ triangleIdx, block.W1[lane], block.W2[lane] };
+							continue;
+						}
+
+						//Forward: the covered pixels of the row are shaded together, lane i of the packet is lane i of the block
+						InterpolateLane(setup, block.Depth[lane], block.W1[lane], block.W2[lane], uint32_t(lane), packet);
+						pixelIndices[lane] = pixelIdx;
+						++tile.NumFragmentsShaded;
 					}
 
-					//------ Metallic ------
-					int metallic = 0;
-					if (pMat->UseMetalnessMap())
+					if (!keyBindInfo.UseVisibilityBuffer)
 					{
-						float metalSample = pMat->GetMetalnessTexture()->Sample(hitRecord.InterpolatedUV).r;
-						if (metalSample > 0.5f)
-							metallic = 1;
-						else if (metalSample < 0.5f)
-							metallic = 0;
+						ShadePacket(packet, m_Draws[setup.DrawIdx], pixelIndices, pLights);
+						packet.LaneMask = 0;
 					}
-
-					//LambertCookTorrance BRDF
-					RGBColor lamertCookTorranceBRDF = BRDF::LambertCookTorrance(diffuse, metallic, roughness, -lightDir, hitRecord.ViewDirection, newNormal);
-
-					//Adding up contribution
-					finalColor += irradiance * lamertCookTorranceBRDF;
 				}
 			}
+
+			for (int32_t e = 0; e < 3; ++e)
+				blockEdges[e] += blockStepX[e];
 		}
-		else
-		{
-			finalColor = hitRecord.InterpolatedColor;
-		}
+		for (int32_t e = 0; e < 3; ++e)
+			blockRowEdges[e] += blockStepY[e];
 	}
+}
+
+void Elite::Renderer::InterpolateLane(const TriangleSetup& setup, float depth, float w1, float w2, uint32_t lane, ShadingPacket& packet) const
+{
+	//Only interpolate the other attributes for pixels that survived the depth test
+	HitRecord& hitRecord = packet.HitRecords[lane];
+	hitRecord.InterpolatedZ = depth;
+	Triangle::Interpolate(setup, w1, w2, hitRecord);
+	packet.LaneMask |= 1u << lane;
+}
 
-	//Call max to one on color overflow
-	if (finalColor.r > 1.f || finalColor.g > 1.f || finalColor.b > 1.f)
-		finalColor.MaxToOne();
+void Elite::Renderer::ShadePacket(ShadingPacket& packet, const DrawShading& draw, const uint32_t* pPixelIndices, const std::vector<Light*>& pLights)
+{
+	//You can start shading these pixels now, with the permutation picked for their draw
+	draw.pShadingFunction(packet, draw.Descriptor, pLights);
+
+	for (int32_t lane = 0; lane < BRDF_PACKET_WIDTH; ++lane)
+	{
+		if ((packet.LaneMask & (1u << lane)) == 0)
+			continue;
 
-	return finalColor;
-}
\ No newline at end of file
+		//Call max to one on color overflow
+		RGBColor& finalColor = packet.Colors[lane];
+		if (finalColor.r > 1.f || finalColor.g > 1.f || finalColor.b > 1.f)
+			finalColor.MaxToOne();
+
+		//Fill the pixels
+		m_pBackBufferPixels[pPixelIndices[lane]] = SDL_MapRGB(m_pBackBuffer->format,
+			static_cast<uint8_t>(finalColor.r * 255.f),
+			static_cast<uint8_t>(finalColor.g * 255.f),
+			static_cast<uint8_t>(finalColor.b * 255.f));
+	}
+}
@@ -10,7 +10,12 @@
 #include <cstdint>
 #include <vector>
 #include "MaterialManager.h"
+#include "Material.h"
+#include "ShadingPermutations.h"
 #include "LightManager.h"
+#include "Triangle.h"
+#include "Structs.h"
+#include "RasterKernels.h"
 
 struct HitRecord;
 struct SDL_Window;
@@ -18,8 +23,9 @@ struct SDL_Surface;
 struct KeyBindInfo;
 
 class TriangleMesh;
-class Triangle;
 class Camera;
+class ThreadPool;
+class FrameArena;
 class Material;
 
 //Render type
@@ -53,6 +59,9 @@ namespace Elite
 			- in the view of the given camera */
 		void Render(const std::vector<TriangleMesh*>& pTriangleMeshes, const MaterialManager& materials, LightManager& lights, Camera* pCamera, const KeyBindInfo& keyBindInfo, ERendererType type);
 
+		/* Returns the counters of the last frame rendered by the software rasterizer */
+		const FrameStats& GetFrameStats() const { return m_FrameStats; }
+
 		/* Save back buffer pixels to image */
 		bool SaveBackbufferToImage() const;
 
@@ -73,6 +82,59 @@ namespace Elite
 		SDL_Surface* m_pBackBuffer;
 		uint32_t* m_pBackBufferPixels;
 		std::vector<float> m_DepthBuffer;
+		uint32_t m_ClearColor;
+		FrameStats m_FrameStats;
+
+		/* SRAS Visibility Buffer, triangle and barycentric weights of the closest fragment of every pixel */
+		struct VisibilitySample
+		{
+			uint32_t TriangleIdx = INVALID_TRIANGLE;
+			float W1 = 0.f;
+			float W2 = 0.f;
+		};
+
+		static const uint32_t INVALID_TRIANGLE = UINT32_MAX;
+		std::vector<VisibilitySample> m_VisibilityBuffer;
+
+		/* SRAS Draws, materials and their shading function are resolved once per mesh, binned triangles refer to their draw by index */
+		struct DrawShading
+		{
+			ShadingDescriptor Descriptor = {};
+			ShadingFunction pShadingFunction = nullptr;
+		};
+		std::vector<DrawShading> m_Draws;
+
+		/* SRAS Vertex Cache, every vertex of the mesh that's being drawn, transformed once per frame */
+		std::vector<Vertex_Output> m_TransformedVertices;
+
+		/* SRAS Clipping, triangles made by clipping only live for a single frame */
+		FrameArena* m_pClipArena;
+
+		/* SRAS Tile Binning */
+		/* Screen-space rectangle of pixels [Min, Max), every tile exclusively owns its part of the depth- and backbuffer */
+		struct RasterTile
+		{
+			uint32_t MinX = 0;
+			uint32_t MinY = 0;
+			uint32_t MaxX = 0;
+			uint32_t MaxY = 0;
+			std::vector<uint32_t> TriangleIndices = {};
+
+			//Counters of this tile, summed up into the frame stats
+			uint64_t NumFragmentsRasterized = 0;
+			uint64_t NumFragmentsShaded = 0;
+		};
+
+		static const uint32_t TILE_SIZE = 64;
+		uint32_t m_NumTilesX;
+		uint32_t m_NumTilesY;
+		std::vector<RasterTile> m_Tiles;
+		std::vector<TriangleSetup> m_BinnedTriangles;
+		ThreadPool* m_pThreadPool;
+
+		/* SRAS Block Kernel, the widest one this CPU supports */
+		ERasterKernel m_RasterKernel;
+		RasterBlockFunction m_pRasterBlock;
 
 		/* DirectX Variables */
 		ID3D11Device* m_pDevice;
@@ -93,8 +155,34 @@ namespace Elite
 		void RenderSRAS(const std::vector<TriangleMesh*>& pTriangleMeshes, const MaterialManager& materials, const LightManager& lights, Camera* pCamera, const KeyBindInfo& keyBindInfo);
 		void RenderDX(const std::vector<TriangleMesh*>& pTriangleMeshes, const MaterialManager& materials, const LightManager& lights, Camera* pCamera);
 
-		void PixelLoop(const Triangle& triangle, const MaterialManager& materialManager, const std::vector<Light*>& pLights, const KeyBindInfo& keyBindInfo);
-		Elite::RGBColor PixelShading(const HitRecord& hitRecord, const MaterialManager& materialManager, const std::vector<Light*>& pLights, const KeyBindInfo& keyBindInfo);
+		/* Computes the matrices and camera variables that stay the same for every vertex of the mesh */
+		DrawConstants GetDrawConstants(const TriangleMesh* pTriangleMesh, const Camera* pCamera) const;
+
+		/* Tests the mesh's bounding volume against the frustum, so invisible meshes skip vertex processing
+			and meshes that lie inside of the (guard band) clipping planes let their triangles skip culling and clipping */
+		EFrustumTest TestFrustum(const BoundingVolume& volume, const DrawConstants& constants, const Elite::FVector2& guardBand) const;
+
+		/* Transforms every vertex of the mesh's vertex buffer into the vertex cache, triangles get assembled from it by index */
+		void TransformMeshVertices(const TriangleMesh* pTriangleMesh, const DrawConstants& constants);
+
+		/* Sets up the (screen space) triangle for this frame and adds it to every tile its bounding box overlaps
+			The draw index links it to the shading of the mesh it belongs to */
+		void BinTriangle(const Triangle& triangle, uint32_t drawIdx);
+
+		/* Clears the pixels of the tile and rasterizes all triangles binned into it, in submission order
+			With the visibility buffer enabled, every visible pixel is shaded exactly once afterwards */
+		void RenderTile(RasterTile& tile, const std::vector<Light*>& pLights, const KeyBindInfo& keyBindInfo);
+
+		void PixelLoop(uint32_t triangleIdx, RasterTile& tile, const std::vector<Light*>& pLights, const KeyBindInfo& keyBindInfo);
+
+		/* Shades the closest fragment of every pixel of the tile stored in the visibility buffer */
+		void ShadeVisibilityBuffer(RasterTile& tile, const std::vector<Light*>& pLights);
+
+		/* Interpolates the attributes of the triangle at the given weights into a lane of the packet */
+		void InterpolateLane(const TriangleSetup& setup, float depth, float w1, float w2, uint32_t lane, ShadingPacket& packet) const;
+
+		/* Shades the lanes of the packet with the shading function of their draw and fills their pixels (pPixelIndices[lane]) with the result */
+		void ShadePacket(ShadingPacket& packet, const DrawShading& draw, const uint32_t* pPixelIndices, const std::vector<Light*>& pLights);
 	};
 }
 
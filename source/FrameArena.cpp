@@ -0,0 +1,45 @@
+#pragma once
+#include "pch.h"
+#include "FrameArena.h"
+
+FrameArena::FrameArena(size_t capacity)
+	: m_pBuffer(nullptr)
+	, m_Capacity(capacity)
+	, m_Offset(0)
+	, m_RequestedBytes(0)
+{
+	m_pBuffer = new uint8_t[m_Capacity];
+}
+
+FrameArena::~FrameArena()
+{
+	delete[] m_pBuffer;
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+	//Align relative to the actual address, the buffer itself is only aligned for fundamental types
+	const uintptr_t address = reinterpret_cast<uintptr_t>(m_pBuffer) + m_Offset;
+	const size_t padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+
+	m_RequestedBytes += padding + size;
+	if (m_Offset + padding + size > m_Capacity)
+		return nullptr;
+
+	void* pMemory = m_pBuffer + m_Offset + padding;
+	m_Offset += padding + size;
+	return pMemory;
+}
+
+void FrameArena::Reset()
+{
+	//Grow outside of the frame instead of failing every frame
+	if (m_RequestedBytes > m_Capacity)
+	{
+		delete[] m_pBuffer;
+		m_Capacity = std::max(m_RequestedBytes, m_Capacity * 2);
+		m_pBuffer = new uint8_t[m_Capacity];
+	}
+	m_Offset = 0;
+	m_RequestedBytes = 0;
+}
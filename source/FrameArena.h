@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/* Linear allocator for data that only lives for a single frame
+	Allocating is a pointer bump, everything is freed at once by Reset, objects are never destructed */
+class FrameArena final
+{
+public:
+	FrameArena(size_t capacity);
+	~FrameArena();
+
+	FrameArena(const FrameArena& a) = delete;
+	FrameArena(FrameArena&& a) = delete;
+	FrameArena& operator=(const FrameArena& a) = delete;
+	FrameArena& operator=(FrameArena&& a) = delete;
+
+	/* Returns uninitialized memory for the given amount of objects, nullptr when the arena is full
+		Only use it for trivially destructible types */
+	template<typename T>
+	T* Allocate(size_t count = 1) { return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T))); }
+
+	/* Returns uninitialized memory of the given size and alignment (power of 2), nullptr when the arena is full */
+	void* Allocate(size_t size, size_t alignment);
+
+	/* Frees all allocations at once
+		If the arena ran out of memory since the last reset, it grows first so the next frame fits */
+	void Reset();
+
+	/* Returns amount of bytes that are currently handed out (alignment padding included) */
+	size_t GetUsedBytes() const { return m_Offset; }
+
+	/* Returns amount of bytes the arena can hand out before it's full */
+	size_t GetCapacity() const { return m_Capacity; }
+
+private:
+	uint8_t* m_pBuffer;
+	size_t m_Capacity;
+	size_t m_Offset;
+	size_t m_RequestedBytes; //Bytes that would have been used if the arena was big enough
+};
@@ -19,6 +19,8 @@ enum class EKeyboardInput : int
 	ToggleSamplerState = SDL_SCANCODE_F,
 	ToggleTransparency = SDL_SCANCODE_T,
 	ToggleCullMode = SDL_SCANCODE_C,
+	ToggleRasterThreads = SDL_SCANCODE_M,
+	ToggleVisibilityBuffer = SDL_SCANCODE_V,
 	StopRotating = SDL_SCANCODE_SPACE,
 	TakeScreenshot = SDL_SCANCODE_X,
 	PreviousScene = SDL_SCANCODE_F1,
@@ -145,6 +145,16 @@ void MainScene::UpdateKeyInputs()
 			std::cout << "Blend State - BLEND NONE\n";
 		}
 	}
+	//------------------- RASTER THREADS -------------------
+	else if (input.IsPressed(EKeyboardInput::ToggleRasterThreads))
+	{
+		ToggleRasterThreadCount();
+	}
+	//------------------- SHADING MODE -------------------
+	else if (input.IsPressed(EKeyboardInput::ToggleVisibilityBuffer))
+	{
+		ToggleVisibilityBuffer();
+	}
 	//------------------- DISPLAY INFO -------------------
 	else if (input.IsPressed(EKeyboardInput::DisplayKeyBindInfo))
 	{
@@ -170,6 +180,7 @@ void MainScene::InitializeMaterials()
 	pMatVehicle->SetShininess(25.f);
 	pMatVehicle->SetSpecularTexture("./Resources/vehicle/vehicle_specular.png", pDevice);
 	pMatVehicle->SetGlossinessTexture("./Resources/vehicle/vehicle_gloss.png", pDevice);
+	pMatVehicle->PackScalarTextures();
 	AddMaterial(pMatVehicle);
 
 	//Combustion Fire Material + Effect
@@ -236,6 +247,10 @@ void MainScene::DisplayKeyBindInfo()
 		"+--------------------------------------+-----+\n" <<
 		"| Toggle CullModes (SRAS and DX)       |  C  |\n" <<
 		"+--------------------------------------+-----+\n" <<
+		"| Toggle Raster Threads (SRAS)         |  M  |\n" <<
+		"+--------------------------------------+-----+\n" <<
+		"| Toggle Visibility Buffer (SRAS)      |  V  |\n" <<
+		"+--------------------------------------+-----+\n" <<
 		"| Toggle Mesh Rotation                 |SPACE|\n" <<
 		"+--------------------------------------+-----+\n" <<
 		"| Previous Scene                       |  F1 |\n" <<
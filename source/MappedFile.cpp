@@ -0,0 +1,37 @@
+#pragma once
+#include "pch.h"
+#include "MappedFile.h"
+
+MappedFile::MappedFile(const char* filepath)
+	: m_FileHandle(INVALID_HANDLE_VALUE)
+	, m_MappingHandle(nullptr)
+	, m_pData(nullptr)
+	, m_Size(0)
+{
+	//Other processes can map (or replace) the file at the same time
+	m_FileHandle = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_FileHandle == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(m_FileHandle, &size) || size.QuadPart <= 0)
+		return;
+
+	m_MappingHandle = CreateFileMappingA(m_FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_MappingHandle)
+		return;
+
+	m_pData = static_cast<const uint8_t*>(MapViewOfFile(m_MappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (m_pData)
+		m_Size = size_t(size.QuadPart);
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_MappingHandle)
+		CloseHandle(m_MappingHandle);
+	if (m_FileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(m_FileHandle);
+}
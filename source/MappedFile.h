@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/* Read-only view of a whole file mapped into memory
+	Pages only get read from the disk when they're touched, and processes mapping the same file share them */
+class MappedFile final
+{
+public:
+	/* Maps the file, IsOpen returns false if it doesn't exist or can't be mapped */
+	MappedFile(const char* filepath);
+	~MappedFile();
+
+	MappedFile(const MappedFile& m) = delete;
+	MappedFile(MappedFile&& m) = delete;
+	MappedFile& operator=(const MappedFile& m) = delete;
+	MappedFile& operator=(MappedFile&& m) = delete;
+
+	/* Returns true if the file is mapped */
+	bool IsOpen() const { return m_pData != nullptr; }
+
+	/* Returns start of the file contents, nullptr if it isn't mapped */
+	const uint8_t* GetData() const { return m_pData; }
+
+	/* Returns size of the file in bytes */
+	size_t GetSize() const { return m_Size; }
+
+private:
+	void* m_FileHandle;
+	void* m_MappingHandle;
+	const uint8_t* m_pData;
+	size_t m_Size;
+};
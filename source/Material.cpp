@@ -3,6 +3,7 @@
 #include "Texture.h"
 #include "Material.h"
 #include "Effect.h"
+#include "TextureCache.h"
 
 Material::Material(unsigned int materialID, MaterialWorkflow workflow, Effect* effect)
 	: m_MaterialID(materialID)
@@ -25,52 +26,159 @@ Material::Material(unsigned int materialID, MaterialWorkflow workflow, Effect* e
 	, m_pMetalnessTexture(nullptr)
 	, m_UseRoughnessMap(false)
 	, m_pRoughnessTexture(nullptr)
+	, m_pPackedTexture(nullptr)
+	, m_PackScalarTextures(false)
+	, m_PendingTextures()
+	, m_AddressMode(ETextureAddressMode::Wrap)
+	, m_BorderColor(Elite::RGBColor(0, 0, 0))
 {
 }
 
+ShadingDescriptor Material::GetShadingDescriptor() const
+{
+	ShadingDescriptor descriptor{};
+	descriptor.Flags = SHADING_HAS_MATERIAL;
+	if (m_MatWorkflow == MaterialWorkflow::MetalRough) descriptor.Flags |= SHADING_METAL_ROUGH;
+	if (m_UseDiffuseMap) descriptor.Flags |= SHADING_DIFFUSE_MAP;
+	if (m_UseNormalMap) descriptor.Flags |= SHADING_NORMAL_MAP;
+	if (m_UseSpecularMap) descriptor.Flags |= SHADING_SPECULAR_MAP;
+	if (m_UseGlossinessMap) descriptor.Flags |= SHADING_GLOSSINESS_MAP;
+	if (m_UseMetalnessMap) descriptor.Flags |= SHADING_METALNESS_MAP;
+	if (m_UseRoughnessMap) descriptor.Flags |= SHADING_ROUGHNESS_MAP;
+	if (m_pPackedTexture) descriptor.Flags |= SHADING_PACKED_MAP;
+
+	descriptor.pDiffuseTexture = m_pDiffuseTexture;
+	descriptor.pNormalTexture = m_pNormalTexture;
+	descriptor.pSpecularTexture = m_pSpecularTexture;
+	descriptor.pGlossinessTexture = m_pGlossinessTexture;
+	descriptor.pMetalnessTexture = m_pMetalnessTexture;
+	descriptor.pRoughnessTexture = m_pRoughnessTexture;
+	descriptor.pPackedTexture = m_pPackedTexture;
+
+	descriptor.DiffuseReflectance = m_DiffuseReflectance;
+	descriptor.DiffuseColor = GetDiffuseColor() * m_DiffuseReflectance;
+	descriptor.SpecularColor = m_SpecularColor;
+	descriptor.Shininess = m_Shininess;
+	descriptor.SpecularReflectance = m_SpecularReflectance;
+	descriptor.Sampler.AddressMode = m_AddressMode;
+	descriptor.Sampler.BorderColor = m_BorderColor;
+	return descriptor;
+}
+
 Material::~Material()
 {
-	delete m_pDiffuseTexture;
-	delete m_pNormalTexture;
-	delete m_pSpecularTexture;
-	delete m_pGlossinessTexture;
-	delete m_pMetalnessTexture;
-	delete m_pRoughnessTexture;
+	TextureCache& textureCache = TextureCache::GetInstance();
+	for (const PendingTexture& pending : m_PendingTextures)
+		textureCache.Release(pending.Future.get());
+	textureCache.Release(m_pDiffuseTexture);
+	textureCache.Release(m_pNormalTexture);
+	textureCache.Release(m_pSpecularTexture);
+	textureCache.Release(m_pGlossinessTexture);
+	textureCache.Release(m_pMetalnessTexture);
+	textureCache.Release(m_pRoughnessTexture);
+	delete m_pPackedTexture;
 	delete m_pEffect;
 }
 
+/* Returns the compressed format when the texture cache asks for block compression */
+static ETextureFormat GetTextureFormat(ETextureFormat format, ETextureFormat compressedFormat)
+{
+	return TextureCache::GetInstance().UsesBlockCompression() ? compressedFormat : format;
+}
+
 void Material::SetDiffuseTexture(const char* filepath, ID3D11Device* pDevice)
 {
-	m_pDiffuseTexture = new Texture(filepath, pDevice); 
-	m_UseDiffuseMap = true; 
+	LoadTexture(m_pDiffuseTexture, m_UseDiffuseMap, filepath, pDevice, GetTextureFormat(ETextureFormat::RGBA8, ETextureFormat::BC1));
 }
 
 void Material::SetNormalTexture(const char* filepath, ID3D11Device* pDevice)
 {
-	m_pNormalTexture = new Texture(filepath, pDevice); 
-	m_UseNormalMap = true;
+	LoadTexture(m_pNormalTexture, m_UseNormalMap, filepath, pDevice, GetTextureFormat(ETextureFormat::RGBA8, ETextureFormat::BC5));
 }
 
 void Material::SetSpecularTexture(const char* filepath, ID3D11Device* pDevice)
 {
-	m_pSpecularTexture = new Texture(filepath, pDevice); 
-	m_UseSpecularMap = true;
+	LoadTexture(m_pSpecularTexture, m_UseSpecularMap, filepath, pDevice, GetTextureFormat(ETextureFormat::RGBA8, ETextureFormat::BC1));
 }
 
 void Material::SetGlossinessTexture(const char* filepath, ID3D11Device* pDevice)
 {
-	m_pGlossinessTexture = new Texture(filepath, pDevice); 
-	m_UseGlossinessMap = true;
+	LoadTexture(m_pGlossinessTexture, m_UseGlossinessMap, filepath, pDevice, GetTextureFormat(ETextureFormat::R8, ETextureFormat::BC4));
 }
 
 void Material::SetMetalnessTexture(const char* filepath, ID3D11Device* pDevice)
 {
-	m_pMetalnessTexture = new Texture(filepath, pDevice); 
-	m_UseMetalnessMap = true;
+	LoadTexture(m_pMetalnessTexture, m_UseMetalnessMap, filepath, pDevice, GetTextureFormat(ETextureFormat::R8, ETextureFormat::BC4));
 }
 
 void Material::SetRoughnessTexture(const char* filepath, ID3D11Device* pDevice)
 {
-	m_pRoughnessTexture = new Texture(filepath, pDevice); 
-	m_UseRoughnessMap = true;
+	LoadTexture(m_pRoughnessTexture, m_UseRoughnessMap, filepath, pDevice, GetTextureFormat(ETextureFormat::R8, ETextureFormat::BC4));
+}
+
+void Material::ResolveTextures()
+{
+	if (m_PendingTextures.empty() && !m_PackScalarTextures)
+		return;
+
+	for (const PendingTexture& pending : m_PendingTextures)
+	{
+		*pending.ppTexture = pending.Future.get();
+		*pending.pUseMap = (*pending.ppTexture != nullptr);
+	}
+	m_PendingTextures.clear();
+
+	if (m_PackScalarTextures)
+	{
+		m_PackScalarTextures = false;
+		BuildPackedTexture();
+	}
+}
+
+void Material::LoadTexture(const Texture*& pTexture, bool& useMap, const char* filepath, ID3D11Device* pDevice, ETextureFormat format)
+{
+	TextureCache& textureCache = TextureCache::GetInstance();
+
+	//Replaces what the member held or was still loading
+	for (size_t i = 0; i < m_PendingTextures.size(); ++i)
+	{
+		if (m_PendingTextures[i].ppTexture != &pTexture)
+			continue;
+
+		textureCache.Release(m_PendingTextures[i].Future.get());
+		m_PendingTextures.erase(m_PendingTextures.begin() + i);
+		break;
+	}
+	textureCache.Release(pTexture);
+	pTexture = nullptr;
+	useMap = false;
+
+	m_PendingTextures.push_back({ &pTexture, &useMap, textureCache.AcquireAsync(filepath, pDevice, format) });
+}
+
+void Material::BuildPackedTexture()
+{
+	delete m_pPackedTexture;
+	m_pPackedTexture = nullptr;
+
+	const Texture* pFirst = (m_MatWorkflow == MaterialWorkflow::MetalRough) ? m_pRoughnessTexture : m_pSpecularTexture;
+	const Texture* pSecond = (m_MatWorkflow == MaterialWorkflow::MetalRough) ? m_pMetalnessTexture : m_pGlossinessTexture;
+	if (!pFirst || !pSecond || pFirst->GetWidth() != pSecond->GetWidth() || pFirst->GetHeight() != pSecond->GetHeight()
+		|| pFirst->IsBlockCompressed() || pSecond->IsBlockCompressed())
+		return;
+
+	TextureChannelSource channels[4]{};
+	if (m_MatWorkflow == MaterialWorkflow::MetalRough)
+	{
+		channels[0] = { m_pRoughnessTexture, 0 };
+		channels[1] = { m_pMetalnessTexture, 0 };
+	}
+	else
+	{
+		channels[0] = { m_pSpecularTexture, 0 };
+		channels[1] = { m_pSpecularTexture, 1 };
+		channels[2] = { m_pSpecularTexture, 2 };
+		channels[3] = { m_pGlossinessTexture, 0 };
+	}
+	m_pPackedTexture = new Texture(channels);
 }
@@ -1,6 +1,44 @@
 #pragma once
+#include "Structs.h"
+#include <vector>
+#include <future>
+
 class Texture;
 class Effect;
+enum class ETextureFormat : unsigned int;
+
+/* Bits of ShadingDescriptor::Flags */
+static const uint32_t SHADING_HAS_MATERIAL = 1 << 0;
+static const uint32_t SHADING_METAL_ROUGH = 1 << 1; //SpecGloss workflow otherwise
+static const uint32_t SHADING_DIFFUSE_MAP = 1 << 2;
+static const uint32_t SHADING_NORMAL_MAP = 1 << 3;
+static const uint32_t SHADING_SPECULAR_MAP = 1 << 4;
+static const uint32_t SHADING_GLOSSINESS_MAP = 1 << 5;
+static const uint32_t SHADING_METALNESS_MAP = 1 << 6;
+static const uint32_t SHADING_ROUGHNESS_MAP = 1 << 7;
+static const uint32_t SHADING_PACKED_MAP = 1 << 8; //Scalar maps come from 1 packed texture, see Material::PackScalarTextures
+static const uint32_t NUM_SHADING_FLAGS = 9; //Every combination of the flags gets its own shading function, keep up to date when adding one
+
+/* Everything the software rasterizer needs to shade a pixel with a material, resolved once per draw instead of once per pixel
+	A default constructed descriptor (no SHADING_HAS_MATERIAL) shades black */
+struct ShadingDescriptor
+{
+	uint32_t Flags = 0;
+	const Texture* pDiffuseTexture = nullptr;
+	const Texture* pNormalTexture = nullptr;
+	const Texture* pSpecularTexture = nullptr;
+	const Texture* pGlossinessTexture = nullptr;
+	const Texture* pMetalnessTexture = nullptr;
+	const Texture* pRoughnessTexture = nullptr;
+	const Texture* pPackedTexture = nullptr;
+	float DiffuseReflectance = 1.f;
+	Elite::RGBColor DiffuseColor = {}; //Already multiplied with the diffuse reflectance
+	Elite::RGBColor SpecularColor = {};
+	float Shininess = 0.f;
+	float SpecularReflectance = 0.f;
+	TextureSampler Sampler = {}; //Address mode of the material, filter of the mesh its sampler state
+};
+
 class Material final
 {
 public:
@@ -24,18 +62,21 @@ public:
 	Effect* GetEffect() const { return m_pEffect; }
 	const MaterialWorkflow& GetMaterialWorkflow() const { return m_MatWorkflow; }
 
+	/* Returns the flags, textures and constants of this material in the form the software rasterizer shades with */
+	ShadingDescriptor GetShadingDescriptor() const;
+
 	/* Diffuse */
 	bool UseDiffuseMap() const { return m_UseDiffuseMap; }
 	float GetDiffuseReflectance() const { return m_DiffuseReflectance; }
 	const Elite::RGBColor& GetDiffuseColor() const { return m_SpecularColor; }
-	Texture* GetDiffuseTexture() const { return m_pDiffuseTexture; }
+	const Texture* GetDiffuseTexture() const { return m_pDiffuseTexture; }
 	void SetDiffuseTexture(const char* filepath, ID3D11Device* pDevice);
 	void SetDiffuseReflectance(float reflectance) { m_DiffuseReflectance = reflectance; }
 	void SetDiffuseColor(const Elite::RGBColor& color) { m_DiffuseColor = color; }
 
 	/* Normal */
 	bool UseNormalMap() const { return m_UseNormalMap; }
-	Texture* GetNormalTexture() const { return m_pNormalTexture; }
+	const Texture* GetNormalTexture() const { return m_pNormalTexture; }
 	void SetNormalTexture(const char* filepath, ID3D11Device* pDevice);
 	
 	/* Specular */
@@ -43,7 +84,7 @@ public:
 	float GetShininess() const { return m_Shininess; }
 	float GetSpecularReflectance() const { return m_SpecularReflectance; }
 	const Elite::RGBColor& GetSpecularColor() const { return m_SpecularColor; }
-	Texture* GetSpecularTexture() const { return m_pSpecularTexture; }
+	const Texture* GetSpecularTexture() const { return m_pSpecularTexture; }
 	void SetShininess(float shininess) { m_Shininess = shininess; }
 	void SetSpecularTexture(const char* filepath, ID3D11Device* pDevice);
 	void SetSpecularReflectance(float reflectance) { m_SpecularReflectance = reflectance; }
@@ -51,19 +92,35 @@ public:
 
 	/* Glossiness */
 	bool UseGlossinessMap() const { return m_UseGlossinessMap; }
-	Texture* GetGlossinessTexture() const { return m_pGlossinessTexture; }
+	const Texture* GetGlossinessTexture() const { return m_pGlossinessTexture; }
 	void SetGlossinessTexture(const char* filepath, ID3D11Device* pDevice);
 
 	/* Metallic */
 	bool UseMetalnessMap() const { return m_UseMetalnessMap; }
-	Texture* GetMetalnessTexture() const { return m_pMetalnessTexture; }
+	const Texture* GetMetalnessTexture() const { return m_pMetalnessTexture; }
 	void SetMetalnessTexture(const char* filepath, ID3D11Device* pDevice);
 
 	/* Roughness */
 	bool UseRoughnessMap() const { return m_UseRoughnessMap; }
-	Texture* GetRoughnessTexture() const { return m_pRoughnessTexture; }
+	const Texture* GetRoughnessTexture() const { return m_pRoughnessTexture; }
 	void SetRoughnessTexture(const char* filepath, ID3D11Device* pDevice);
 
+	/* Packs the scalar maps into 1 texture, so the software rasterizer fetches them with a single sample per pixel
+		SpecGloss: specular (rgb) + glossiness (a), MetalRough: roughness (r) + metalness (g)
+		Happens in ResolveTextures, only when both maps are set, uncompressed and have the same size
+		The individual maps stay loaded, the DX effects bind them and other materials can share them */
+	void PackScalarTextures() { m_PackScalarTextures = true; }
+
+	/* Textures load in the background after setting them, this waits for the ones that are still loading (and packs them when asked to)
+		Call before the textures get used, cheap when there's nothing left to wait for */
+	void ResolveTextures();
+
+	/* Sampling (software rasterizer) */
+	ETextureAddressMode GetAddressMode() const { return m_AddressMode; }
+	const Elite::RGBColor& GetBorderColor() const { return m_BorderColor; }
+	void SetAddressMode(ETextureAddressMode addressMode) { m_AddressMode = addressMode; }
+	void SetBorderColor(const Elite::RGBColor& color) { m_BorderColor = color; }
+
 private:
 	unsigned int m_MaterialID;
 	MaterialWorkflow m_MatWorkflow;
@@ -71,24 +128,45 @@ private:
 
 	bool m_UseDiffuseMap;
 	float m_DiffuseReflectance;
-	Texture* m_pDiffuseTexture;
+	const Texture* m_pDiffuseTexture; //Shared through the texture cache
 	Elite::RGBColor m_DiffuseColor;
 
 	bool m_UseNormalMap;
-	Texture* m_pNormalTexture;
+	const Texture* m_pNormalTexture; //Shared through the texture cache
 
 	bool m_UseSpecularMap;
 	float m_Shininess;
 	float m_SpecularReflectance;
-	Texture* m_pSpecularTexture;
+	const Texture* m_pSpecularTexture; //Shared through the texture cache
 	Elite::RGBColor m_SpecularColor;
 
 	bool m_UseGlossinessMap;
-	Texture* m_pGlossinessTexture;
+	const Texture* m_pGlossinessTexture; //Shared through the texture cache
 
 	bool m_UseMetalnessMap;
-	Texture* m_pMetalnessTexture;
+	const Texture* m_pMetalnessTexture; //Shared through the texture cache
 
 	bool m_UseRoughnessMap;
-	Texture* m_pRoughnessTexture;
+	const Texture* m_pRoughnessTexture; //Shared through the texture cache
+
+	Texture* m_pPackedTexture; //Owned, not cached
+	bool m_PackScalarTextures;
+
+	/* Texture that's still loading, stored in its member (and its map enabled) once resolved */
+	struct PendingTexture
+	{
+		const Texture** ppTexture;
+		bool* pUseMap;
+		std::shared_future<const Texture*> Future;
+	};
+	std::vector<PendingTexture> m_PendingTextures;
+
+	ETextureAddressMode m_AddressMode;
+	Elite::RGBColor m_BorderColor;
+
+	/* Starts loading the texture into the given member, replacing the texture it held */
+	void LoadTexture(const Texture*& pTexture, bool& useMap, const char* filepath, ID3D11Device* pDevice, ETextureFormat format);
+
+	/* Builds the packed texture out of the loaded scalar maps */
+	void BuildPackedTexture();
 };
\ No newline at end of file
@@ -2,7 +2,6 @@
 #include "pch.h"
 #include "MaterialManager.h"
 #include "Material.h"
-#include <algorithm>
 
 MaterialManager::~MaterialManager()
 {
@@ -12,22 +11,28 @@ MaterialManager::~MaterialManager()
         m_pMaterials[i] = nullptr;
     }
     m_pMaterials.clear();
+    m_pMaterialsByID.clear();
 }
 
-void MaterialManager::AddMaterial(Material* pMaterial)
+void MaterialManager::ResolveTextures()
 {
-    if (pMaterial) m_pMaterials.push_back(pMaterial);
+    for (Material* pMaterial : m_pMaterials)
+        pMaterial->ResolveTextures();
 }
 
-Material* MaterialManager::GetMaterialByID(unsigned int id) const
+void MaterialManager::AddMaterial(Material* pMaterial)
 {
-    auto it = std::find_if(m_pMaterials.begin(), m_pMaterials.end(), [id](Material* pMaterial)
-        {
-            return (pMaterial->GetMaterialID() == id);
-        });
+    if (!pMaterial)
+        return;
+
+    m_pMaterials.push_back(pMaterial);
+
+    //Material IDs are small and dense, so they directly index the lookup table
+    const unsigned int id = pMaterial->GetMaterialID();
+    if (id >= m_pMaterialsByID.size())
+        m_pMaterialsByID.resize(size_t(id) + 1, nullptr);
 
-    if (it == m_pMaterials.end())
-        return nullptr;
-    else
-        return (*it);
+    //Like the linear search used to, the first material added with an ID wins
+    if (!m_pMaterialsByID[id])
+        m_pMaterialsByID[id] = pMaterial;
 }
\ No newline at end of file
@@ -16,13 +16,17 @@ public:
 	/* Adds material to the material manager class */
 	void AddMaterial(Material* pMaterial);
 
+	/* Waits for the textures of all materials that are still loading, see Material::ResolveTextures */
+	void ResolveTextures();
+
 	/* Returns const reference to the vector holding all the material pointers */
 	const std::vector<Material*>& GetMaterials() const { return m_pMaterials; }
 
-	/* Looks through all materials and returns the material with the similar ID to the passed parameter ID
+	/* Returns the material with the passed ID (constant time, IDs index a dense table)
 		returns nullptr on invalid ID */
-	Material* GetMaterialByID(unsigned int id) const;
+	Material* GetMaterialByID(unsigned int id) const { return (id < m_pMaterialsByID.size()) ? m_pMaterialsByID[id] : nullptr; }
 
 private:
 	std::vector<Material*> m_pMaterials;
+	std::vector<Material*> m_pMaterialsByID; //Not owning, nullptr for IDs without a material
 };
\ No newline at end of file
@@ -0,0 +1,229 @@
+#pragma once
+#include "pch.h"
+#include "RasterKernels.h"
+
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+//MSVC allows the use of any intrinsic without changing the target architecture, GCC and Clang need to know per function
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TARGET_SSE4
+#define TARGET_AVX2
+#else
+#define TARGET_SSE4 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+void PrepareRasterBlock(const TriangleSetup& setup, RasterBlockSetup& blockSetup)
+{
+	for (int32_t lane = 0; lane < RASTER_BLOCK_WIDTH; ++lane)
+	{
+		for (int32_t e = 0; e < 3; ++e)
+			blockSetup.EdgeLaneOffsets[e][lane] = setup.Edges[e].StepX * lane;
+
+		blockSetup.WeightLaneOffsets[0][lane] = float(setup.Edges[1].StepX * lane) * setup.InvArea;
+		blockSetup.WeightLaneOffsets[1][lane] = float(setup.Edges[2].StepX * lane) * setup.InvArea;
+	}
+	blockSetup.InvArea = setup.InvArea;
+	blockSetup.InvDepth = setup.InvDepthSS;
+}
+
+//========SCALAR========
+static uint32_t RasterBlockScalar(const RasterBlockSetup& blockSetup, RasterBlock& block)
+{
+	const float w1Base = float(block.Edges[1]) * blockSetup.InvArea;
+	const float w2Base = float(block.Edges[2]) * blockSetup.InvArea;
+
+	uint32_t mask = 0;
+	for (int32_t lane = 0; lane < RASTER_BLOCK_WIDTH; ++lane)
+	{
+		if ((block.LaneMask & (1u << lane)) == 0)
+			continue;
+
+		//Inside-outside test
+		const int64_t edge0 = block.Edges[0] + blockSetup.EdgeLaneOffsets[0][lane];
+		const int64_t edge1 = block.Edges[1] + blockSetup.EdgeLaneOffsets[1][lane];
+		const int64_t edge2 = block.Edges[2] + blockSetup.EdgeLaneOffsets[2][lane];
+		if (!block.IsFullyCovered && (edge0 | edge1 | edge2) < 0)
+			continue;
+
+		//Depth test
+		block.W1[lane] = w1Base + blockSetup.WeightLaneOffsets[0][lane];
+		block.W2[lane] = w2Base + blockSetup.WeightLaneOffsets[1][lane];
+		block.Depth[lane] = 1.f / blockSetup.InvDepth.Evaluate(block.W1[lane], block.W2[lane]);
+		if (block.Depth[lane] > 0.f && block.Depth[lane] < 1.f && block.Depth[lane] <= block.pDepthBuffer[lane])
+			mask |= 1u << lane;
+	}
+	return mask;
+}
+
+//========SSE4========
+TARGET_SSE4 static uint32_t RasterBlockSSE4(const RasterBlockSetup& blockSetup, RasterBlock& block)
+{
+	//Inside-outside test, 2 64-bit edge values per register -> 4 registers per edge
+	uint32_t mask = (1u << RASTER_BLOCK_WIDTH) - 1;
+	for (int32_t i = 0; i < RASTER_BLOCK_WIDTH && !block.IsFullyCovered; i += 2)
+	{
+		__m128i edgesOr = _mm_setzero_si128();
+		for (int32_t e = 0; e < 3; ++e)
+		{
+			const __m128i offsets = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&blockSetup.EdgeLaneOffsets[e][i]));
+			edgesOr = _mm_or_si128(edgesOr, _mm_add_epi64(_mm_set1_epi64x(block.Edges[e]), offsets));
+		}
+		//Sign bit of every lane ends up in the mask, inside when none is set
+		mask &= ~(uint32_t(_mm_movemask_pd(_mm_castsi128_pd(edgesOr))) << i);
+	}
+	mask &= block.LaneMask;
+	if (mask == 0)
+		return 0;
+
+	//Depth test, 4 lanes per register
+	const __m128 w1Base = _mm_set1_ps(float(block.Edges[1]) * blockSetup.InvArea);
+	const __m128 w2Base = _mm_set1_ps(float(block.Edges[2]) * blockSetup.InvArea);
+	const __m128 base = _mm_set1_ps(blockSetup.InvDepth.Base);
+	const __m128 deltaW1 = _mm_set1_ps(blockSetup.InvDepth.DeltaW1);
+	const __m128 deltaW2 = _mm_set1_ps(blockSetup.InvDepth.DeltaW2);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+
+	uint32_t depthMask = 0;
+	for (int32_t i = 0; i < RASTER_BLOCK_WIDTH; i += 4)
+	{
+		const __m128 w1 = _mm_add_ps(w1Base, _mm_loadu_ps(&blockSetup.WeightLaneOffsets[0][i]));
+		const __m128 w2 = _mm_add_ps(w2Base, _mm_loadu_ps(&blockSetup.WeightLaneOffsets[1][i]));
+		const __m128 invDepth = _mm_add_ps(base, _mm_add_ps(_mm_mul_ps(w1, deltaW1), _mm_mul_ps(w2, deltaW2)));
+		const __m128 depth = _mm_div_ps(one, invDepth);
+
+		__m128 passed = _mm_and_ps(_mm_cmpgt_ps(depth, zero), _mm_cmplt_ps(depth, one));
+		passed = _mm_and_ps(passed, _mm_cmple_ps(depth, _mm_loadu_ps(&block.pDepthBuffer[i])));
+		depthMask |= uint32_t(_mm_movemask_ps(passed)) << i;
+
+		_mm_storeu_ps(&block.W1[i], w1);
+		_mm_storeu_ps(&block.W2[i], w2);
+		_mm_storeu_ps(&block.Depth[i], depth);
+	}
+	return mask & depthMask;
+}
+
+//========AVX2========
+TARGET_AVX2 static uint32_t RasterBlockAVX2(const RasterBlockSetup& blockSetup, RasterBlock& block)
+{
+	//Inside-outside test, 4 64-bit edge values per register -> 2 registers per edge
+	uint32_t mask = block.LaneMask;
+	if (!block.IsFullyCovered)
+	{
+		__m256i edgesOrLow = _mm256_setzero_si256();
+		__m256i edgesOrHigh = _mm256_setzero_si256();
+		for (int32_t e = 0; e < 3; ++e)
+		{
+			const __m256i edge = _mm256_set1_epi64x(block.Edges[e]);
+			const __m256i offsetsLow = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&blockSetup.EdgeLaneOffsets[e][0]));
+			const __m256i offsetsHigh = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&blockSetup.EdgeLaneOffsets[e][4]));
+			edgesOrLow = _mm256_or_si256(edgesOrLow, _mm256_add_epi64(edge, offsetsLow));
+			edgesOrHigh = _mm256_or_si256(edgesOrHigh, _mm256_add_epi64(edge, offsetsHigh));
+		}
+		//Sign bit of every lane ends up in the mask, inside when none is set
+		const uint32_t outside = uint32_t(_mm256_movemask_pd(_mm256_castsi256_pd(edgesOrLow)))
+			| (uint32_t(_mm256_movemask_pd(_mm256_castsi256_pd(edgesOrHigh))) << 4);
+		mask &= ~outside;
+	}
+	if (mask == 0)
+		return 0;
+
+	//Depth test, all 8 lanes in one register
+	const __m256 w1 = _mm256_add_ps(_mm256_set1_ps(float(block.Edges[1]) * blockSetup.InvArea), _mm256_loadu_ps(blockSetup.WeightLaneOffsets[0]));
+	const __m256 w2 = _mm256_add_ps(_mm256_set1_ps(float(block.Edges[2]) * blockSetup.InvArea), _mm256_loadu_ps(blockSetup.WeightLaneOffsets[1]));
+	//No FMA on purpose, it rounds differently and would make the kernels disagree on depth ties
+	const __m256 invDepth = _mm256_add_ps(_mm256_set1_ps(blockSetup.InvDepth.Base),
+		_mm256_add_ps(_mm256_mul_ps(w1, _mm256_set1_ps(blockSetup.InvDepth.DeltaW1)), _mm256_mul_ps(w2, _mm256_set1_ps(blockSetup.InvDepth.DeltaW2))));
+	const __m256 one = _mm256_set1_ps(1.f);
+	const __m256 depth = _mm256_div_ps(one, invDepth);
+
+	__m256 passed = _mm256_and_ps(_mm256_cmp_ps(depth, _mm256_setzero_ps(), _CMP_GT_OQ), _mm256_cmp_ps(depth, one, _CMP_LT_OQ));
+	passed = _mm256_and_ps(passed, _mm256_cmp_ps(depth, _mm256_loadu_ps(block.pDepthBuffer), _CMP_LE_OQ));
+
+	_mm256_storeu_ps(block.W1, w1);
+	_mm256_storeu_ps(block.W2, w2);
+	_mm256_storeu_ps(block.Depth, depth);
+	return mask & uint32_t(_mm256_movemask_ps(passed));
+}
+
+//========DISPATCH========
+static void CpuId(int32_t info[4], int32_t function, int32_t subFunction)
+{
+#if defined(_MSC_VER)
+	__cpuidex(info, function, subFunction);
+#else
+	unsigned int a = 0, b = 0, c = 0, d = 0;
+	__cpuid_count(function, subFunction, a, b, c, d);
+	info[0] = int32_t(a); info[1] = int32_t(b); info[2] = int32_t(c); info[3] = int32_t(d);
+#endif
+}
+
+static uint64_t ReadExtendedControlRegister()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int low = 0, high = 0;
+	__asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+	return (uint64_t(high) << 32) | low;
+#endif
+}
+
+ERasterKernel GetBestRasterKernel()
+{
+	int32_t info[4] = {};
+	CpuId(info, 0, 0);
+	const int32_t maxFunction = info[0];
+
+	CpuId(info, 1, 0);
+	const bool hasSSE41 = (info[2] & (1 << 19)) != 0;
+	const bool hasAVX = (info[2] & (1 << 28)) != 0;
+	const bool hasOSXSave = (info[2] & (1 << 27)) != 0;
+
+	//AVX registers are only usable when the OS saves them on a context switch
+	const bool isAVXEnabled = hasAVX && hasOSXSave && (ReadExtendedControlRegister() & 0x6) == 0x6;
+	if (isAVXEnabled && maxFunction >= 7)
+	{
+		CpuId(info, 7, 0);
+		const bool hasAVX2 = (info[1] & (1 << 5)) != 0;
+		if (hasAVX2)
+			return ERasterKernel::AVX2;
+	}
+
+	if (hasSSE41)
+		return ERasterKernel::SSE4;
+
+	return ERasterKernel::Scalar;
+}
+
+RasterBlockFunction GetRasterBlockFunction(ERasterKernel kernel)
+{
+	switch (kernel)
+	{
+	case ERasterKernel::AVX2:
+		return &RasterBlockAVX2;
+	case ERasterKernel::SSE4:
+		return &RasterBlockSSE4;
+	default:
+		return &RasterBlockScalar;
+	}
+}
+
+const char* GetRasterKernelName(ERasterKernel kernel)
+{
+	switch (kernel)
+	{
+	case ERasterKernel::AVX2:
+		return "AVX2";
+	case ERasterKernel::SSE4:
+		return "SSE4";
+	default:
+		return "SCALAR";
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include "Structs.h"
+
+/* Amount of horizontally adjacent pixels (8x1) the block kernels process at once */
+static const int32_t RASTER_BLOCK_WIDTH = 8;
+
+/* Amount of rows of a block in the hierarchical traversal, the kernels test one row of a block per call */
+static const int32_t RASTER_BLOCK_HEIGHT = 8;
+
+/* Per triangle constants of the block kernels, filled in once per triangle by PrepareRasterBlock */
+struct RasterBlockSetup
+{
+	//Value to add to the edge function/weight of the first pixel in the block to get the one of each lane
+	int64_t EdgeLaneOffsets[3][RASTER_BLOCK_WIDTH] = {};
+	float WeightLaneOffsets[2][RASTER_BLOCK_WIDTH] = {};
+	float InvArea = {};
+	AttributePlane InvDepth = {};
+};
+
+/* A single block of pixels to test, the kernel fills in the weights and depth of every lane */
+struct RasterBlock
+{
+	//Input
+	int64_t Edges[3] = {};            //Edge function values of the first pixel of the block
+	uint32_t LaneMask = {};           //Lanes (bit i = pixel i) that lie inside the rasterized range
+	bool IsFullyCovered = {};         //Block lies completely inside the triangle, no need to test the edges
+	const float* pDepthBuffer = {};   //Current depth of the 8 pixels of the block
+
+	//Output
+	float W1[RASTER_BLOCK_WIDTH] = {};
+	float W2[RASTER_BLOCK_WIDTH] = {};
+	float Depth[RASTER_BLOCK_WIDTH] = {};
+};
+
+/* Evaluates the edge functions, depth and depth test of all pixels of the block at once
+	Returns the mask of lanes that are covered by the triangle and pass the depth test */
+using RasterBlockFunction = uint32_t(*)(const RasterBlockSetup& blockSetup, RasterBlock& block);
+
+enum class ERasterKernel : unsigned int
+{
+	Scalar = 0,
+	SSE4 = 1,
+	AVX2 = 2
+};
+
+/* Fills in the per triangle constants of the block kernels */
+void PrepareRasterBlock(const TriangleSetup& setup, RasterBlockSetup& blockSetup);
+
+/* Returns the widest kernel this CPU (and OS) supports, checked with CPUID */
+ERasterKernel GetBestRasterKernel();
+
+/* Returns the block function of the given kernel */
+RasterBlockFunction GetRasterBlockFunction(ERasterKernel kernel);
+
+/* Returns the name of the kernel, useful for printing */
+const char* GetRasterKernelName(ERasterKernel kernel);
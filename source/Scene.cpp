@@ -8,6 +8,7 @@
 #include "ERenderer.h"
 #include "Material.h"
 #include "Camera.h"
+#include "ThreadPool.h"
 #include <iostream>
 
 Scene::Scene(SDL_Window* pWindow, const std::string& sceneTag)
@@ -59,6 +60,23 @@ void Scene::AddLight(Light* pLight)
 	m_LightManager.AddLight(pLight);
 }
 
+void Scene::ToggleRasterThreadCount()
+{
+	//0 means all hardware threads are used
+	uint32_t maxThreads = ThreadPool::GetHardwareThreadCount();
+	uint32_t numThreads = (m_KeyBindInfo.NumRasterThreads == 0) ? maxThreads : m_KeyBindInfo.NumRasterThreads;
+	numThreads = (numThreads >= maxThreads) ? 1 : std::min(numThreads * 2, maxThreads);
+
+	m_KeyBindInfo.NumRasterThreads = numThreads;
+	std::cout << "Raster Threads - " << numThreads << "\n";
+}
+
+void Scene::ToggleVisibilityBuffer()
+{
+	m_KeyBindInfo.UseVisibilityBuffer = !m_KeyBindInfo.UseVisibilityBuffer;
+	std::cout << "Shading Mode - " << (m_KeyBindInfo.UseVisibilityBuffer ? "VISIBILITY BUFFER" : "FORWARD") << "\n";
+}
+
 void Scene::SetRendererType(ERendererType type)
 {
 	m_RendererType = type;
@@ -107,6 +125,9 @@ void Scene::SetSceneIndex(int sceneIdx)
 
 void Scene::RootRender()
 {
+	//Textures kept loading in the background since initialization, only the first frame can have to wait
+	m_MaterialManager.ResolveTextures();
+
 	//Render all triangle meshes
 	m_pRenderer->Render(m_pTriangleMeshes, m_MaterialManager, m_LightManager, m_pCamera, m_KeyBindInfo, m_RendererType);
 }
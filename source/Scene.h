@@ -95,6 +95,12 @@ protected:
 	/* Adds a new material to the current scene */
 	void AddMaterial(Material* pMaterial);
 
+	/* Doubles the amount of threads the software rasterizer uses, wraps back to 1 thread after the hardware limit */
+	void ToggleRasterThreadCount();
+
+	/* Switches the software rasterizer between forward shading and deferred shading from a visibility buffer */
+	void ToggleVisibilityBuffer();
+
 	/* Adds a new light to the current scene
 		Keep in mind, there's only a maximum number of lights allowed due to limitations of hlsl shader*/
 	void AddLight(Light* pLight);
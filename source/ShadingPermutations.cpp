@@ -0,0 +1,295 @@
+#pragma once
+#include "pch.h"
+#include "ShadingPermutations.h"
+#include "Texture.h"
+#include "Light.h"
+
+#include <array>
+#include <type_traits>
+#include <utility>
+
+//Features are picked with overloads on std::true_type/std::false_type instead of branching on a constant,
+//so every permutation only contains the code of its own features (and C++14 has no if constexpr)
+template<uint32_t Flags, uint32_t Flag>
+using HasFlag = std::integral_constant<bool, (Flags & Flag) != 0>;
+
+//========FEATURES========
+static inline RGBColor SampleTexture(const Texture* pTexture, const HitRecord& hitRecord, const ShadingDescriptor& shading)
+{
+	return pTexture->Sample(hitRecord.InterpolatedUV, hitRecord.UVDerivativeX, hitRecord.UVDerivativeY, shading.Sampler);
+}
+
+static inline RGBColor SampleTexture(const Texture* pTexture, const HitRecord& hitRecord, const ShadingDescriptor& shading, float& alpha)
+{
+	return pTexture->Sample(hitRecord.InterpolatedUV, hitRecord.UVDerivativeX, hitRecord.UVDerivativeY, shading.Sampler, alpha);
+}
+
+static RGBColor GetDiffuse(const HitRecord& hitRecord, const ShadingDescriptor& shading, std::true_type)
+{
+	return SampleTexture(shading.pDiffuseTexture, hitRecord, shading) * shading.DiffuseReflectance;
+}
+
+static RGBColor GetDiffuse(const HitRecord&, const ShadingDescriptor& shading, std::false_type)
+{
+	return shading.DiffuseColor;
+}
+
+static FVector3 GetNormal(const HitRecord& hitRecord, const ShadingDescriptor& shading, std::true_type)
+{
+	//We define our tangent space
+	const FVector3 binormal = Cross(hitRecord.InterpolatedTangent, hitRecord.InterpolatedVertexNormal);
+	const FMatrix3 localTangentSpace = FMatrix3(hitRecord.InterpolatedTangent, binormal, hitRecord.InterpolatedVertexNormal);
+
+	//Sampled value is returned in range [0, 1], while we will need this in [-1, 1]
+	RGBColor normalSample = SampleTexture(shading.pNormalTexture, hitRecord, shading);
+	normalSample = (normalSample * 2.f) - RGBColor(1.f, 1.f, 1.f);
+
+	//Transform to tangent space
+	return GetNormalized(localTangentSpace * FVector3(normalSample.r, normalSample.g, normalSample.b));
+}
+
+static FVector3 GetNormal(const HitRecord& hitRecord, const ShadingDescriptor&, std::false_type)
+{
+	//This value is already normalized
+	return hitRecord.InterpolatedVertexNormal;
+}
+
+static RGBColor GetSpecularColor(const HitRecord& hitRecord, const ShadingDescriptor& shading, std::true_type)
+{
+	return SampleTexture(shading.pSpecularTexture, hitRecord, shading);
+}
+
+static RGBColor GetSpecularColor(const HitRecord&, const ShadingDescriptor& shading, std::false_type)
+{
+	return shading.SpecularColor;
+}
+
+static float GetShininess(const HitRecord& hitRecord, const ShadingDescriptor& shading, std::true_type)
+{
+	return shading.Shininess * SampleTexture(shading.pGlossinessTexture, hitRecord, shading).r;
+}
+
+static float GetShininess(const HitRecord&, const ShadingDescriptor& shading, std::false_type)
+{
+	return shading.Shininess;
+}
+
+static float GetRoughness(const HitRecord& hitRecord, const ShadingDescriptor& shading, std::true_type)
+{
+	return SampleTexture(shading.pRoughnessTexture, hitRecord, shading).r;
+}
+
+static float GetRoughness(const HitRecord&, const ShadingDescriptor&, std::false_type)
+{
+	return 0.6f;
+}
+
+static int GetMetallic(const HitRecord& hitRecord, const ShadingDescriptor& shading, std::true_type)
+{
+	return (SampleTexture(shading.pMetalnessTexture, hitRecord, shading).r > 0.5f) ? 1 : 0;
+}
+
+static int GetMetallic(const HitRecord&, const ShadingDescriptor&, std::false_type)
+{
+	return 0;
+}
+
+/* Specular color and shininess, from the packed texture (1 sample) or from the separate maps */
+template<uint32_t Flags>
+static void GetSpecularGloss(const HitRecord& hitRecord, const ShadingDescriptor& shading, RGBColor& specularColor, float& shininess, std::true_type)
+{
+	float glossiness = 0.f;
+	specularColor = SampleTexture(shading.pPackedTexture, hitRecord, shading, glossiness);
+	shininess = shading.Shininess * glossiness;
+}
+
+template<uint32_t Flags>
+static void GetSpecularGloss(const HitRecord& hitRecord, const ShadingDescriptor& shading, RGBColor& specularColor, float& shininess, std::false_type)
+{
+	specularColor = GetSpecularColor(hitRecord, shading, HasFlag<Flags, SHADING_SPECULAR_MAP>{});
+	shininess = GetShininess(hitRecord, shading, HasFlag<Flags, SHADING_GLOSSINESS_MAP>{});
+}
+
+/* Roughness and metalness, from the packed texture (1 sample) or from the separate maps */
+template<uint32_t Flags>
+static void GetRoughnessMetallic(const HitRecord& hitRecord, const ShadingDescriptor& shading, float& roughness, float& metalness, std::true_type)
+{
+	const RGBColor sample = SampleTexture(shading.pPackedTexture, hitRecord, shading);
+	roughness = sample.r;
+	metalness = (sample.g > 0.5f) ? 1.f : 0.f;
+}
+
+template<uint32_t Flags>
+static void GetRoughnessMetallic(const HitRecord& hitRecord, const ShadingDescriptor& shading, float& roughness, float& metalness, std::false_type)
+{
+	roughness = GetRoughness(hitRecord, shading, HasFlag<Flags, SHADING_ROUGHNESS_MAP>{});
+	metalness = float(GetMetallic(hitRecord, shading, HasFlag<Flags, SHADING_METALNESS_MAP>{}));
+}
+
+//========WORKFLOWS========
+/* Widest BRDF kernels this CPU supports, picked once */
+static const BRDFKernels& s_BRDFKernels = GetBRDFKernels(GetBestRasterKernel());
+
+static inline bool IsLaneActive(const ShadingPacket& packet, int32_t lane)
+{
+	return (packet.LaneMask & (1u << lane)) != 0;
+}
+
+/* Fills in the direction towards the light of every lane and returns the irradiance of every lane */
+static void GatherLight(const ShadingPacket& packet, const Light* pLight, const FVector3* pNormals, BRDFPacket& brdf, RGBColor* pIrradiance)
+{
+	for (int32_t lane = 0; lane < BRDF_PACKET_WIDTH; ++lane)
+	{
+		if (!IsLaneActive(packet, lane))
+			continue;
+
+		//Because of lightDir being initialized for a LHS in DX, we have to invert Z to get same effect
+		pIrradiance[lane] = pLight->GetCalculatedIrradianceColor(pNormals[lane], true);
+		const FVector3 lightDir = -pLight->GetDirection(packet.HitRecords[lane], true);
+		brdf.LightX[lane] = lightDir.x;
+		brdf.LightY[lane] = lightDir.y;
+		brdf.LightZ[lane] = lightDir.z;
+	}
+}
+
+/* SpecGloss: lambert diffuse + phong specular */
+template<uint32_t Flags>
+static void ShadeLights(ShadingPacket& packet, const ShadingDescriptor& shading, const RGBColor* pDiffuse, const FVector3* pNormals, BRDFPacket& brdf, const std::vector<Light*>& pLights, std::false_type)
+{
+	//Texture samples don't depend on the light, so they're only taken once
+	RGBColor specColors[BRDF_PACKET_WIDTH]{};
+	RGBColor lambertDiffuse[BRDF_PACKET_WIDTH]{};
+	for (int32_t lane = 0; lane < BRDF_PACKET_WIDTH; ++lane)
+	{
+		if (!IsLaneActive(packet, lane))
+			continue;
+
+		const HitRecord& hitRecord = packet.HitRecords[lane];
+		GetSpecularGloss<Flags>(hitRecord, shading, specColors[lane], brdf.Shininess[lane], HasFlag<Flags, SHADING_PACKED_MAP>{});
+		brdf.SpecularReflectance[lane] = shading.SpecularReflectance;
+		lambertDiffuse[lane] = pDiffuse[lane] / float(E_PI);
+	}
+
+	RGBColor irradiance[BRDF_PACKET_WIDTH]{};
+	for (Light* pLight : pLights)
+	{
+		GatherLight(packet, pLight, pNormals, brdf, irradiance);
+		s_BRDFKernels.Phong(brdf);
+
+		for (int32_t lane = 0; lane < BRDF_PACKET_WIDTH; ++lane)
+		{
+			if (IsLaneActive(packet, lane))
+				packet.Colors[lane] += irradiance[lane] * lambertDiffuse[lane] + specColors[lane] * RGBColor(brdf.R[lane], brdf.G[lane], brdf.B[lane]);
+		}
+	}
+}
+
+/* MetalRough: lambert cook-torrance */
+template<uint32_t Flags>
+static void ShadeLights(ShadingPacket& packet, const ShadingDescriptor& shading, const RGBColor* pDiffuse, const FVector3* pNormals, BRDFPacket& brdf, const std::vector<Light*>& pLights, std::true_type)
+{
+	//Texture samples don't depend on the light, so they're only taken once
+	for (int32_t lane = 0; lane < BRDF_PACKET_WIDTH; ++lane)
+	{
+		if (!IsLaneActive(packet, lane))
+			continue;
+
+		const HitRecord& hitRecord = packet.HitRecords[lane];
+		GetRoughnessMetallic<Flags>(hitRecord, shading, brdf.Roughness[lane], brdf.Metalness[lane], HasFlag<Flags, SHADING_PACKED_MAP>{});
+		brdf.AlbedoR[lane] = pDiffuse[lane].r;
+		brdf.AlbedoG[lane] = pDiffuse[lane].g;
+		brdf.AlbedoB[lane] = pDiffuse[lane].b;
+	}
+
+	RGBColor irradiance[BRDF_PACKET_WIDTH]{};
+	for (Light* pLight : pLights)
+	{
+		GatherLight(packet, pLight, pNormals, brdf, irradiance);
+		s_BRDFKernels.LambertCookTorrance(brdf);
+
+		for (int32_t lane = 0; lane < BRDF_PACKET_WIDTH; ++lane)
+		{
+			if (IsLaneActive(packet, lane))
+				packet.Colors[lane] += irradiance[lane] * RGBColor(brdf.R[lane], brdf.G[lane], brdf.B[lane]);
+		}
+	}
+}
+
+//========PERMUTATIONS========
+template<uint32_t Flags>
+static void ShadeMaterial(ShadingPacket& packet, const ShadingDescriptor& shading, const std::vector<Light*>& pLights, std::true_type)
+{
+	//Surface of every lane, the BRDF kernels take them as structure of arrays
+	RGBColor diffuse[BRDF_PACKET_WIDTH]{};
+	FVector3 normals[BRDF_PACKET_WIDTH]{};
+	BRDFPacket brdf{};
+	for (int32_t lane = 0; lane < BRDF_PACKET_WIDTH; ++lane)
+	{
+		if (!IsLaneActive(packet, lane))
+			continue;
+
+		const HitRecord& hitRecord = packet.HitRecords[lane];
+		diffuse[lane] = GetDiffuse(hitRecord, shading, HasFlag<Flags, SHADING_DIFFUSE_MAP>{});
+		normals[lane] = GetNormal(hitRecord, shading, HasFlag<Flags, SHADING_NORMAL_MAP>{});
+		brdf.NormalX[lane] = normals[lane].x;
+		brdf.NormalY[lane] = normals[lane].y;
+		brdf.NormalZ[lane] = normals[lane].z;
+		brdf.ViewX[lane] = hitRecord.ViewDirection.x;
+		brdf.ViewY[lane] = hitRecord.ViewDirection.y;
+		brdf.ViewZ[lane] = hitRecord.ViewDirection.z;
+		packet.Colors[lane] = RGBColor(0.f, 0.f, 0.f);
+	}
+	ShadeLights<Flags>(packet, shading, diffuse, normals, brdf, pLights, HasFlag<Flags, SHADING_METAL_ROUGH>{});
+}
+
+template<uint32_t Flags>
+static void ShadeMaterial(ShadingPacket& packet, const ShadingDescriptor&, const std::vector<Light*>&, std::false_type)
+{
+	//Draw without a (matching) material
+	for (RGBColor& color : packet.Colors)
+		color = RGBColor(0.f, 0.f, 0.f);
+}
+
+template<uint32_t Flags>
+static void ShadePermutation(ShadingPacket& packet, const ShadingDescriptor& shading, const std::vector<Light*>& pLights)
+{
+	ShadeMaterial<Flags>(packet, shading, pLights, HasFlag<Flags, SHADING_HAS_MATERIAL>{});
+}
+
+/* Table of all permutations, indexed by the flags, generated at compile time */
+template<uint32_t... Flags>
+static std::array<ShadingFunction, sizeof...(Flags)> MakeShadingTable(std::integer_sequence<uint32_t, Flags...>)
+{
+	return { { &ShadePermutation<Flags>... } };
+}
+
+static const std::array<ShadingFunction, NUM_SHADING_PERMUTATIONS> s_ShadingTable = MakeShadingTable(std::make_integer_sequence<uint32_t, NUM_SHADING_PERMUTATIONS>{});
+
+//========VIEWS========
+static void ShadeDepth(ShadingPacket& packet, const ShadingDescriptor&, const std::vector<Light*>&)
+{
+	//Use depth as gradient for color
+	for (int32_t lane = 0; lane < BRDF_PACKET_WIDTH; ++lane)
+	{
+		const float depthColor = Elite::Remap(packet.HitRecords[lane].InterpolatedZ, 0.985f, 1.f);
+		packet.Colors[lane] = RGBColor{ depthColor, depthColor, depthColor };
+	}
+}
+
+static void ShadeVertexColor(ShadingPacket& packet, const ShadingDescriptor&, const std::vector<Light*>&)
+{
+	//If not using material, then use the color defined in the triangle
+	for (int32_t lane = 0; lane < BRDF_PACKET_WIDTH; ++lane)
+		packet.Colors[lane] = packet.HitRecords[lane].InterpolatedColor;
+}
+
+ShadingFunction GetShadingFunction(const ShadingDescriptor& shading, const KeyBindInfo& keyBindInfo)
+{
+	if (keyBindInfo.UseDepthBufferAsColor)
+		return &ShadeDepth;
+
+	if (!keyBindInfo.UseMaterial)
+		return &ShadeVertexColor;
+
+	return s_ShadingTable[shading.Flags & (NUM_SHADING_PERMUTATIONS - 1)];
+}
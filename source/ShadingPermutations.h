@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Structs.h"
+#include "Material.h"
+#include "BRDFKernels.h"
+
+class Light;
+
+/* Pixels of the same draw that get shaded together, a lane per pixel, so the BRDFs can be evaluated for all of them at once */
+struct ShadingPacket
+{
+	uint32_t LaneMask = 0; //Lanes (bit i = lane i) that hold a pixel
+	HitRecord HitRecords[BRDF_PACKET_WIDTH] = {};
+	Elite::RGBColor Colors[BRDF_PACKET_WIDTH] = {}; //Output, not clamped yet
+};
+
+/* Shades the lanes of the packet with the material of its draw and the given lights */
+using ShadingFunction = void(*)(ShadingPacket& packet, const ShadingDescriptor& shading, const std::vector<Light*>& pLights);
+
+/* Amount of shading functions generated, one per combination of the SHADING_* flags */
+static const uint32_t NUM_SHADING_PERMUTATIONS = 1 << NUM_SHADING_FLAGS;
+
+/* Returns the shading function compiled for exactly the features of the descriptor, meant to be picked once per draw
+	The depth buffer and vertex color views of the keybinds don't look at the material at all */
+ShadingFunction GetShadingFunction(const ShadingDescriptor& shading, const KeyBindInfo& keyBindInfo);
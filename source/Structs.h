@@ -1,7 +1,6 @@
 #pragma once
 #include "EMath.h"
 #include "ERGBColor.h"
-#include "Triangle.h"
 
 using namespace Elite;
 
@@ -12,6 +11,8 @@ struct HitRecord
 	float InterpolatedW = {};
 	RGBColor InterpolatedColor = {};
 	FVector2 InterpolatedUV = {};
+	FVector2 UVDerivativeX = {}; //UV difference with the pixel to the right, what a 2x2 quad would give
+	FVector2 UVDerivativeY = {}; //UV difference with the pixel below
 	FVector3 InterpolatedVertexNormal = {};
 	FVector3 InterpolatedTangent = {};
 	FVector3 ViewDirection = {};
@@ -62,6 +63,7 @@ struct Vertex_Output
 		this->VertexNormal = v1.VertexNormal;
 		this->UV = v1.UV;
 		this->Tangent = v1.Tangent;
+		this->ViewDirection = v1.ViewDirection;
 		return *this;
 	}
 
@@ -76,15 +78,144 @@ struct Vertex_Output
 	RGBColor Color = {};
 	FVector2 UV = {};
 	FVector3 Tangent = {};
+	FVector3 ViewDirection = {};
+};
+
+/* Constants of a single draw (triangle mesh), computed once per mesh per frame and shared by all of its vertices */
+struct DrawConstants
+{
+	FMatrix4 World = {};
+	FMatrix4 WorldViewProjection = {};
+	FMatrix3 Normal = {};       //Transforms normals and tangents to world space
+	FPoint3 CameraPosition = {};
+	bool InvertToRHS = false;   //Vertices are defined in a lhs (for DirectX) -> invert Z-components to work for a rhs
+};
+
+/* Object space bounding volumes of a mesh: an axis aligned box and a sphere around it */
+struct BoundingVolume
+{
+	FPoint3 Min = {};
+	FPoint3 Max = {};
+	FPoint3 Center = {};
+	float Radius = 0.f;
+};
+
+/* Result of testing a bounding volume against the frustum */
+enum class EFrustumTest : unsigned int
+{
+	Outside = 0,      //Nothing of the volume is visible
+	Intersecting = 1, //Triangles of the volume can need culling or clipping
+	Inside = 2        //Triangles of the volume never need culling or clipping
+};
+
+/* Vertex positions are snapped to fixed-point 24.8 sub-pixel coordinates before rasterizing */
+static const int32_t SUB_PIXEL_BITS = 8;
+static const int32_t SUB_PIXEL_SCALE = 1 << SUB_PIXEL_BITS;
+
+/* Largest absolute screen coordinate (in pixels) that can be rasterized
+	2^29 in fixed-point keeps the triangle area and edge function products (coordinate * coordinate delta) inside of 64 bits */
+static const float MAX_FIXED_POINT_COORDINATE = float(1 << (29 - SUB_PIXEL_BITS));
+
+/* Screen coordinates triangles are allowed to reach without clipping, in pixels from the left/top screen edge (Triangle::GetGuardBand)
+	The band is symmetric around the screen: [width - GUARD_BAND_SIZE, GUARD_BAND_SIZE] horizontally, half of the fixed-point range as margin */
+static const float GUARD_BAND_SIZE = MAX_FIXED_POINT_COORDINATE * 0.5f;
+
+/* Fixed-point edge function of a triangle, positive on the inside (fill rule bias included)
+	Stepping 1 pixel to the right/down is a single integer add of StepX/StepY */
+struct EdgeFunction
+{
+	int64_t StepX = {};
+	int64_t StepY = {};
+	int64_t Origin = {};
+
+	inline int64_t Evaluate(int32_t x, int32_t y) const { return Origin + StepX * x + StepY * y; }
+};
+
+/* Attribute (divided by w) as a plane over the barycentric weights of vertex 1 and 2: Base + w1 * DeltaW1 + w2 * DeltaW2 */
+struct AttributePlane
+{
+	float Base = {};
+	float DeltaW1 = {};
+	float DeltaW2 = {};
+
+	inline void Set(float v0, float v1, float v2) { Base = v0; DeltaW1 = v1 - v0; DeltaW2 = v2 - v0; }
+	inline float Evaluate(float w1, float w2) const { return Base + w1 * DeltaW1 + w2 * DeltaW2; }
+};
+
+/* Outcome of setting up a triangle, only Visible triangles reach the pixel loop */
+enum class ESetupResult : unsigned int
+{
+	Visible = 0,
+	Culled = 1,   //Facing away according to the cullmode
+	Rejected = 2  //Zero area, outside of the fixed-point range or not covering any pixel on screen
+};
+
+/* Everything the pixel loop needs of a triangle, computed once per triangle in Triangle::Setup */
+struct TriangleSetup
+{
+	unsigned int MatID = {};
+	uint32_t DrawIdx = {}; //Draw (mesh) the triangle belongs to, filled in by the renderer
+
+	//Pixels covered by the bounding box, clamped to the screen [Min, Max)
+	int32_t MinX = {};
+	int32_t MinY = {};
+	int32_t MaxX = {};
+	int32_t MaxY = {};
+
+	//Edges[i] lies opposite of vertex i, evaluating it and multiplying with InvArea gives the weight of vertex i
+	EdgeFunction Edges[3] = {};
+	float InvArea = {};
+
+	//Change of the weights of vertex 1 and 2 when stepping 1 pixel to the right/down
+	float W1StepX = {};
+	float W1StepY = {};
+	float W2StepX = {};
+	float W2StepY = {};
+
+	//Perspective correct interpolation: interpolate 1/w and attribute/w linearly, then multiply with the interpolated w
+	AttributePlane InvDepthSS = {};
+	AttributePlane InvDepthVS = {};
+	AttributePlane Color[3] = {};
+	AttributePlane UV[2] = {};
+	AttributePlane VertexNormal[3] = {};
+	AttributePlane Tangent[3] = {};
+	AttributePlane ViewDirection[3] = {};
 };
 
-struct BoundingBox
+/* Counters of the last frame rendered by the software rasterizer */
+struct FrameStats
 {
-	BoundingBox(FPoint2 topLeft, FPoint2 bottomRight) { TopLeft = topLeft; BottomRight = bottomRight; }
-	BoundingBox() {};
+	uint64_t NumTrianglesBinned = 0;     //Triangles (after clipping) that were set up and handed to the pixel loop
+	uint64_t NumTrianglesCulled = 0;     //Triangles (after clipping) dropped by the cullmode at setup
+	uint64_t NumFragmentsRasterized = 0; //Fragments that passed the depth test
+	uint64_t NumFragmentsShaded = 0;     //Fragments that went through pixel shading
+	uint64_t NumHeapAllocations = 0;     //Heap allocations made by the render thread and raster workers while rendering the frame (only tracked in debug builds)
+	                                     //Texture loader threads allocate at the same time, those aren't counted
+};
+
+/* Filtering of the texture samples of the software rasterizer */
+enum class ETextureFilter : unsigned int
+{
+	Point = 0,     //Nearest texel of the nearest mip level
+	Bilinear = 1,  //4 texels of the nearest mip level
+	Trilinear = 2  //4 texels of the 2 closest mip levels
+};
 
-	FPoint2 TopLeft = { FLT_MAX, FLT_MAX };
-	FPoint2 BottomRight = { 0.f, 0.f };
+/* What texture samples outside of [0, 1] return */
+enum class ETextureAddressMode : unsigned int
+{
+	Wrap = 0,   //Texture repeats
+	Clamp = 1,  //Edge texels stretch out
+	Mirror = 2, //Texture repeats, every other copy flipped
+	Border = 3  //Border color
+};
+
+/* How the software rasterizer samples a texture */
+struct TextureSampler
+{
+	ETextureFilter Filter = ETextureFilter::Point;
+	ETextureAddressMode AddressMode = ETextureAddressMode::Wrap;
+	RGBColor BorderColor = {};
 };
 
 /* Don't forget to update the _NR_OF_OPTIONS when adding new options */
@@ -100,6 +231,9 @@ struct KeyBindInfo
 {
 	bool UseDepthBufferAsColor = false;
 	bool UseMaterial = true;
-	bool UseSimpleFrustumCulling = true;
+	bool UseSimpleFrustumCulling = false;
+	bool UseGuardBand = true;
+	bool UseVisibilityBuffer = false;
+	uint32_t NumRasterThreads = 0; //0 = use all hardware threads
 	ImageRenderInfo ImageRenderInfo = ImageRenderInfo::All;
 };
\ No newline at end of file
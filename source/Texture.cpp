@@ -1,50 +1,415 @@
 #pragma once
 #include "pch.h"
 #include "Texture.h"
+#include "MappedFile.h"
 #include "SDL_image.h"
+#include <array>
+#include <atomic>
+#include <climits>
+#include <fstream>
+#include <string>
 
-Texture::Texture(const char* filepath, ID3D11Device* pDevice)
-	: m_pSurface()
+/* Byte to [0, 1] float conversion, a lookup instead of a divide per channel per texel */
+static std::array<float, 256> MakeUNormTable()
+{
+	std::array<float, 256> table{};
+	for (size_t i = 0; i < table.size(); ++i)
+		table[i] = float(i) / 255.f;
+	return table;
+}
+static const std::array<float, 256> s_UNormToFloat = MakeUNormTable();
+
+/* Returns amount of channels a format keeps of the image (before compression) */
+static int GetNumChannels(ETextureFormat format)
+{
+	switch (format)
+	{
+	case ETextureFormat::R8:
+	case ETextureFormat::BC4:
+		return 1;
+	case ETextureFormat::BC5:
+		return 2;
+	default:
+		return 4;
+	}
+}
+
+/* Returns bytes per compressed block of a format, 0 for the uncompressed formats */
+static int GetBlockBytes(ETextureFormat format)
+{
+	switch (format)
+	{
+	case ETextureFormat::BC1:
+	case ETextureFormat::BC4:
+		return 8;
+	case ETextureFormat::BC5:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+/* Decoded compressed block, a bilinear footprint and the neighbouring pixels mostly land in the same few blocks */
+struct DecodedBlock
+{
+	const uint8_t* pBlock = nullptr;
+	uint64_t TexelDataId = 0;
+	uint8_t Texels[16 * 4] = {}; //RGBA8, row by row
+};
+
+/* Direct mapped cache of decoded blocks per thread, 5 KB so it stays in L1 and needs no locking */
+static const uint32_t DECODED_BLOCK_CACHE_BITS = 6;
+static thread_local DecodedBlock s_DecodedBlocks[1 << DECODED_BLOCK_CACHE_BITS];
+
+static std::atomic<uint64_t> s_NextTexelDataId{ 1 };
+
+Texture::TexelColor Texture::LerpTexel(const TexelColor& c0, const TexelColor& c1, float t)
+{
+	TexelColor result{};
+	result.r = c0.r + (c1.r - c0.r) * t;
+	result.g = c0.g + (c1.g - c0.g) * t;
+	result.b = c0.b + (c1.b - c0.b) * t;
+	result.a = c0.a + (c1.a - c0.a) * t;
+	return result;
+}
+
+Texture::Texture(const char* filepath, ID3D11Device* pDevice, ETextureFormat format)
+	: m_Format(format)
+	, m_NumChannels(GetNumChannels(format))
+	, m_BlockBytes(GetBlockBytes(format))
+	, m_pTexture()
+	, m_pTextureResourceView()
+	, m_pTexelData(std::make_shared<TexelData>())
+{
+	Initialize(IMG_Load(filepath), pDevice);
+}
+
+Texture::Texture(const void* pFileData, size_t fileSize, ID3D11Device* pDevice, ETextureFormat format)
+	: m_Format(format)
+	, m_NumChannels(GetNumChannels(format))
+	, m_BlockBytes(GetBlockBytes(format))
+	, m_pTexture()
+	, m_pTextureResourceView()
+	, m_pTexelData(std::make_shared<TexelData>())
+{
+	Initialize(IMG_Load_RW(SDL_RWFromConstMem(pFileData, int(fileSize)), 1), pDevice);
+}
+
+Texture::Texture(const Texture& source, ID3D11Device* pDevice)
+	: m_Format(source.m_Format)
+	, m_NumChannels(source.m_NumChannels)
+	, m_BlockBytes(source.m_BlockBytes)
+	, m_pTexture()
+	, m_pTextureResourceView()
+	, m_MipLevels(source.m_MipLevels)
+	, m_pTexelData(source.m_pTexelData)
+{
+	if (!m_MipLevels.empty())
+		InitializeResources(pDevice);
+}
+
+Texture::Texture(const TextureChannelSource (&channels)[4])
+	: m_Format(ETextureFormat::RGBA8)
+	, m_NumChannels(4)
+	, m_BlockBytes(0)
+	, m_pTexture()
+	, m_pTextureResourceView()
+	, m_pTexelData(std::make_shared<TexelData>())
+{
+	//Same size means the same levels, padding and block layout, so the texels can be packed index by index
+	const Texture* pLayout = nullptr;
+	for (const TextureChannelSource& channel : channels)
+	{
+		if (!pLayout && channel.pTexture)
+			pLayout = channel.pTexture;
+	}
+	if (!pLayout)
+		return;
+
+	const TexelData& layoutData = *pLayout->m_pTexelData;
+	const size_t numTexels = layoutData.NumTexelBytes / size_t(pLayout->m_NumChannels);
+	m_pTexelData->Texels.resize(numTexels * size_t(m_NumChannels));
+	m_pTexelData->TexelOffsets.assign(layoutData.pOffsets, layoutData.pOffsets + layoutData.NumOffsets);
+	for (int c = 0; c < m_NumChannels; ++c)
+	{
+		const Texture* pSource = channels[c].pTexture;
+		if (!pSource)
+			continue;
+
+		const uint8_t* pSourceTexels = pSource->m_pTexelData->pTexels + channels[c].Channel;
+		for (size_t i = 0; i < numTexels; ++i)
+			m_pTexelData->Texels[i * m_NumChannels + c] = pSourceTexels[i * pSource->m_NumChannels];
+	}
+	m_pTexelData->pTexels = m_pTexelData->Texels.data();
+	m_pTexelData->NumTexelBytes = m_pTexelData->Texels.size();
+	m_pTexelData->pOffsets = m_pTexelData->TexelOffsets.data();
+	m_pTexelData->NumOffsets = m_pTexelData->TexelOffsets.size();
+
+	for (const MipLevel& layoutLevel : pLayout->m_MipLevels)
+	{
+		MipLevel level = layoutLevel;
+		level.pTexels = m_pTexelData->pTexels + (layoutLevel.pTexels - layoutData.pTexels) / pLayout->m_NumChannels * m_NumChannels;
+		level.pOffsetsX = m_pTexelData->pOffsets + (layoutLevel.pOffsetsX - layoutData.pOffsets);
+		level.pOffsetsY = m_pTexelData->pOffsets + (layoutLevel.pOffsetsY - layoutData.pOffsets);
+		m_MipLevels.push_back(level);
+	}
+}
+
+/* Layout of a cache file: header, a description per level, the offset tables of all levels, then the texels of all levels
+	The texels start at a multiple of 64 bytes, mapped views start at a page so they stay cache line aligned like in memory */
+static const uint32_t CACHE_FILE_MAGIC = 0x31435854; //"TXC1"
+static const uint32_t CACHE_FILE_VERSION = 1;        //Increase when the layout of the levels changes
+static const size_t CACHE_FILE_TEXEL_ALIGNMENT = 64;
+
+struct CacheFileHeader
+{
+	uint32_t Magic = CACHE_FILE_MAGIC;
+	uint32_t Version = CACHE_FILE_VERSION;
+	uint64_t ContentHash = 0;
+	uint32_t Format = 0;
+	uint32_t BlockSize = 0;
+	uint32_t NumMipLevels = 0;
+	uint32_t NumOffsets = 0;
+	uint64_t NumTexelBytes = 0;
+};
+
+struct CacheFileLevel
+{
+	int32_t Width = 0;
+	int32_t Height = 0;
+	uint32_t OffsetsX = 0;    //Index of the first x offset in the offset tables
+	uint32_t OffsetsY = 0;
+	uint64_t TexelOffset = 0; //Byte offset of the level in the texels
+};
+
+/* Returns the byte offset of the texels in a cache file */
+static size_t GetCacheFileTexelOffset(size_t numMipLevels, size_t numOffsets)
+{
+	const size_t size = sizeof(CacheFileHeader) + numMipLevels * sizeof(CacheFileLevel) + numOffsets * sizeof(uint32_t);
+	return (size + CACHE_FILE_TEXEL_ALIGNMENT - 1) / CACHE_FILE_TEXEL_ALIGNMENT * CACHE_FILE_TEXEL_ALIGNMENT;
+}
+
+Texture::Texture(MappedFile* pCacheFile, uint64_t contentHash, ID3D11Device* pDevice, ETextureFormat format)
+	: m_Format(format)
+	, m_NumChannels(GetNumChannels(format))
+	, m_BlockBytes(GetBlockBytes(format))
 	, m_pTexture()
 	, m_pTextureResourceView()
+	, m_pTexelData(std::make_shared<TexelData>())
 {
-	Initialize(filepath, pDevice);
+	m_pTexelData->pCacheFile = pCacheFile;
+	if (!pCacheFile->IsOpen() || pCacheFile->GetSize() < sizeof(CacheFileHeader))
+		return;
+
+	//Written by another version, for another image or cut short: treated as missing
+	const uint8_t* pData = pCacheFile->GetData();
+	const CacheFileHeader& header = *reinterpret_cast<const CacheFileHeader*>(pData);
+	const bool isUncompressedBC1 = (format == ETextureFormat::BC1) && (header.Format == uint32_t(ETextureFormat::RGBA8)); //Image with alpha
+	if (header.Magic != CACHE_FILE_MAGIC || header.Version != CACHE_FILE_VERSION || header.ContentHash != contentHash
+		|| (header.Format != uint32_t(format) && !isUncompressedBC1) || header.BlockSize != uint32_t(TEXTURE_BLOCK_SIZE) || header.NumMipLevels == 0)
+		return;
+
+	if (isUncompressedBC1)
+	{
+		m_Format = ETextureFormat::RGBA8;
+		m_NumChannels = GetNumChannels(m_Format);
+		m_BlockBytes = GetBlockBytes(m_Format);
+	}
+
+	const size_t texelOffset = GetCacheFileTexelOffset(header.NumMipLevels, header.NumOffsets);
+	if (texelOffset > pCacheFile->GetSize() || header.NumTexelBytes > pCacheFile->GetSize() - texelOffset)
+		return;
+
+	const CacheFileLevel* pLevels = reinterpret_cast<const CacheFileLevel*>(pData + sizeof(CacheFileHeader));
+	m_pTexelData->pOffsets = reinterpret_cast<const uint32_t*>(pData + sizeof(CacheFileHeader) + header.NumMipLevels * sizeof(CacheFileLevel));
+	m_pTexelData->NumOffsets = header.NumOffsets;
+	m_pTexelData->pTexels = pData + texelOffset;
+	m_pTexelData->NumTexelBytes = size_t(header.NumTexelBytes);
+
+	//Every texel a level can address has to lie inside of the file, only the offset tables get touched for that
+	static const int maxSize = 1 << 24;
+	std::vector<MipLevel> levels(header.NumMipLevels);
+	for (size_t i = 0; i < levels.size(); ++i)
+	{
+		const CacheFileLevel& fileLevel = pLevels[i];
+		if (fileLevel.Width <= 0 || fileLevel.Height <= 0 || fileLevel.Width > maxSize || fileLevel.Height > maxSize)
+			return;
+
+		const int offsetsX = GetOffsetTableLength(fileLevel.Width);
+		const int offsetsY = GetOffsetTableLength(fileLevel.Height);
+		if (uint64_t(fileLevel.OffsetsX) + uint64_t(offsetsX) > header.NumOffsets || uint64_t(fileLevel.OffsetsY) + uint64_t(offsetsY) > header.NumOffsets)
+			return;
+
+		const uint64_t numElements = uint64_t(GetNumLevelElements(fileLevel.Width, fileLevel.Height));
+		const uint64_t levelBytes = numElements * uint64_t(GetElementBytes());
+		if (fileLevel.TexelOffset % uint64_t(GetElementBytes()) != 0 || fileLevel.TexelOffset > header.NumTexelBytes || levelBytes > header.NumTexelBytes - fileLevel.TexelOffset)
+			return;
+
+		MipLevel& level = levels[i];
+		level.Width = fileLevel.Width;
+		level.Height = fileLevel.Height;
+		level.pTexels = m_pTexelData->pTexels + fileLevel.TexelOffset;
+		level.pOffsetsX = m_pTexelData->pOffsets + fileLevel.OffsetsX;
+		level.pOffsetsY = m_pTexelData->pOffsets + fileLevel.OffsetsY;
+
+		const uint32_t maxOffsetX = *std::max_element(level.pOffsetsX, level.pOffsetsX + offsetsX);
+		const uint32_t maxOffsetY = *std::max_element(level.pOffsetsY, level.pOffsetsY + offsetsY);
+		if (uint64_t(maxOffsetX) + uint64_t(maxOffsetY) >= numElements)
+			return;
+	}
+	m_MipLevels.swap(levels);
+
+	InitializeResources(pDevice);
+}
+
+Texture::TexelData::TexelData()
+	: Id(s_NextTexelDataId++)
+{
+}
+
+Texture::TexelData::~TexelData()
+{
+	delete pCacheFile;
 }
 
 Texture::~Texture()
 {
-	m_pTextureResourceView->Release();
-	m_pTexture->Release();
-	SDL_FreeSurface(m_pSurface);
+	if (m_pTextureResourceView)
+		m_pTextureResourceView->Release();
+	if (m_pTexture)
+		m_pTexture->Release();
 }
 
-Elite::RGBColor Texture::Sample(const Elite::FVector2& uv) const
+size_t Texture::GetTexelBytes() const
 {
-	Uint8 r;
-	Uint8 g;
-	Uint8 b;
+	return m_pTexelData->NumTexelBytes + m_pTexelData->NumOffsets * sizeof(uint32_t);
+}
 
-	//Extra check if UV components are between [0,1]
-	int x = int(RemapUVComponent(uv.x) * m_pSurface->w);
-	int y = int(RemapUVComponent(uv.y) * m_pSurface->h);
+bool Texture::WriteCacheFile(const char* filepath, uint64_t contentHash) const
+{
+	if (m_MipLevels.empty())
+		return false;
+
+	CacheFileHeader header{};
+	header.ContentHash = contentHash;
+	header.Format = uint32_t(m_Format);
+	header.BlockSize = uint32_t(TEXTURE_BLOCK_SIZE);
+	header.NumMipLevels = uint32_t(m_MipLevels.size());
+	header.NumOffsets = uint32_t(m_pTexelData->NumOffsets);
+	header.NumTexelBytes = uint64_t(m_pTexelData->NumTexelBytes);
+
+	std::vector<CacheFileLevel> levels(m_MipLevels.size());
+	for (size_t i = 0; i < m_MipLevels.size(); ++i)
+	{
+		levels[i].Width = m_MipLevels[i].Width;
+		levels[i].Height = m_MipLevels[i].Height;
+		levels[i].OffsetsX = uint32_t(m_MipLevels[i].pOffsetsX - m_pTexelData->pOffsets);
+		levels[i].OffsetsY = uint32_t(m_MipLevels[i].pOffsetsY - m_pTexelData->pOffsets);
+		levels[i].TexelOffset = uint64_t(m_MipLevels[i].pTexels - m_pTexelData->pTexels);
+	}
+
+	//Written next to the destination under a name of its own, then swapped in, so nobody maps a half written file
+	const std::string temporaryFilepath = std::string(filepath) + "." + std::to_string(GetCurrentProcessId()) + "." + std::to_string(GetCurrentThreadId()) + ".tmp";
+	{
+		std::ofstream file(temporaryFilepath, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		const size_t headerSize = sizeof(CacheFileHeader) + levels.size() * sizeof(CacheFileLevel) + m_pTexelData->NumOffsets * sizeof(uint32_t);
+		const char padding[CACHE_FILE_TEXEL_ALIGNMENT]{};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(levels.data()), std::streamsize(levels.size() * sizeof(CacheFileLevel)));
+		file.write(reinterpret_cast<const char*>(m_pTexelData->pOffsets), std::streamsize(m_pTexelData->NumOffsets * sizeof(uint32_t)));
+		file.write(padding, std::streamsize(GetCacheFileTexelOffset(levels.size(), m_pTexelData->NumOffsets) - headerSize));
+		file.write(reinterpret_cast<const char*>(m_pTexelData->pTexels), std::streamsize(m_pTexelData->NumTexelBytes));
+		if (!file.flush())
+		{
+			file.close();
+			DeleteFileA(temporaryFilepath.c_str());
+			return false;
+		}
+	}
+
+	if (!MoveFileExA(temporaryFilepath.c_str(), filepath, MOVEFILE_REPLACE_EXISTING))
+	{
+		DeleteFileA(temporaryFilepath.c_str());
+		return false;
+	}
+	return true;
+}
+
+Elite::RGBColor Texture::Sample(const Elite::FVector2& uv, const Elite::FVector2& uvDerivativeX, const Elite::FVector2& uvDerivativeY, const TextureSampler& sampler) const
+{
+	float alpha = 0.f;
+	return Sample(uv, uvDerivativeX, uvDerivativeY, sampler, alpha);
+}
+
+Elite::RGBColor Texture::Sample(const Elite::FVector2& uv, const Elite::FVector2& uvDerivativeX, const Elite::FVector2& uvDerivativeY, const TextureSampler& sampler, float& alpha) const
+{
+	//Level of detail: log2 of the amount of full resolution texels a pixel step covers (along the longest of both screen axes)
+	const MipLevel& fullResolution = m_MipLevels[0];
+	const float texelsX = Elite::Square(uvDerivativeX.x * fullResolution.Width) + Elite::Square(uvDerivativeX.y * fullResolution.Height);
+	const float texelsY = Elite::Square(uvDerivativeY.x * fullResolution.Width) + Elite::Square(uvDerivativeY.y * fullResolution.Height);
+	const float maxLevel = float(m_MipLevels.size() - 1);
+	float lod = 0.5f * log2f(std::max(std::max(texelsX, texelsY), 1.f)); //Magnification always uses level 0
+	if (!(lod > 0.f)) //NaN (derivatives of NaN or infinite UVs) fails every comparison, it would index past the levels
+		lod = 0.f;
+	lod = std::min(lod, maxLevel);
+
+	TexelColor texel{};
+	switch (sampler.Filter)
+	{
+	case ETextureFilter::Point:
+		texel = SamplePoint(m_MipLevels[size_t(lod + 0.5f)], uv, sampler);
+		break;
+	case ETextureFilter::Bilinear:
+		texel = SampleBilinear(m_MipLevels[size_t(lod + 0.5f)], uv, sampler);
+		break;
+	case ETextureFilter::Trilinear:
+	default:
+	{
+		const size_t lowerLevel = size_t(lod);
+		const size_t upperLevel = std::min(lowerLevel + 1, m_MipLevels.size() - 1);
+		const float t = lod - float(lowerLevel);
+		texel = LerpTexel(SampleBilinear(m_MipLevels[lowerLevel], uv, sampler), SampleBilinear(m_MipLevels[upperLevel], uv, sampler), t);
+		break;
+	}
+	}
+	alpha = texel.a;
+	return Elite::RGBColor(texel.r, texel.g, texel.b);
+}
 
-	//Determine index -> then get RGB value of the pixel on that index
-	int index = x + (y * m_pSurface->w);
-	Uint32* pixels = (Uint32*)m_pSurface->pixels;
-	SDL_GetRGB(pixels[index], m_pSurface->format, &r, &g, &b);
-	return Elite::RGBColor(r / 255.f, g / 255.f, b / 255.f);
+void Texture::Initialize(SDL_Surface* pLoadedSurface, ID3D11Device* pDevice)
+{
+	if (!LoadTexels(pLoadedSurface))
+		return;
+	BuildMipChain();
+	if (m_BlockBytes)
+		CompressMipChain();
+	else
+		TileMipChain();
+	InitializeResources(pDevice);
 }
 
-void Texture::Initialize(const char* filepath, ID3D11Device* pDevice)
+void Texture::InitializeResources(ID3D11Device* pDevice)
 {
-	m_pSurface = IMG_Load(filepath);
+	//BC1 and BC4 blocks get uploaded as they are, DX only takes them when the full resolution level is a multiple of the block size
+	//BC5 gets decoded, so the effects keep reading z from the normal map
+	const MipLevel& fullResolution = m_MipLevels[0];
+	const bool isSingleChannel = (m_Format == ETextureFormat::R8) || (m_Format == ETextureFormat::BC4);
+	const bool uploadBlocks = ((m_Format == ETextureFormat::BC1) || (m_Format == ETextureFormat::BC4))
+		&& (fullResolution.Width % COMPRESSED_BLOCK_SIZE == 0) && (fullResolution.Height % COMPRESSED_BLOCK_SIZE == 0);
+	const int numChannels = isSingleChannel ? 1 : 4;
 
 	D3D11_TEXTURE2D_DESC desc{};
-	desc.Width = m_pSurface->w;
-	desc.Height = m_pSurface->h;
-	desc.MipLevels = 1;
+	desc.Width = fullResolution.Width;
+	desc.Height = fullResolution.Height;
+	desc.MipLevels = UINT(m_MipLevels.size());
 	desc.ArraySize = 1;
-	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	if (uploadBlocks)
+		desc.Format = (m_Format == ETextureFormat::BC1) ? DXGI_FORMAT_BC1_UNORM : DXGI_FORMAT_BC4_UNORM;
+	else
+		desc.Format = isSingleChannel ? DXGI_FORMAT_R8_UNORM : DXGI_FORMAT_R8G8B8A8_UNORM;
 
 	desc.SampleDesc.Count = 1;
 	desc.SampleDesc.Quality = 0;
@@ -53,32 +418,642 @@ void Texture::Initialize(const char* filepath, ID3D11Device* pDevice)
 	desc.CPUAccessFlags = 0;
 	desc.MiscFlags = 0;
 
-	D3D11_SUBRESOURCE_DATA initData;
-	initData.pSysMem = m_pSurface->pixels;
-	initData.SysMemPitch = static_cast<UINT>(m_pSurface->pitch);
-	initData.SysMemSlicePitch = static_cast<UINT>(m_pSurface->h * m_pSurface->pitch);
+	//Same mip chain on the GPU, so both rasterizers filter alike, DX wants it row by row
+	std::vector<std::vector<uint8_t>> rows(m_MipLevels.size());
+	std::vector<D3D11_SUBRESOURCE_DATA> initData(m_MipLevels.size());
+	for (size_t i = 0; i < m_MipLevels.size(); ++i)
+	{
+		const MipLevel& level = m_MipLevels[i];
+		if (uploadBlocks)
+		{
+			//Rows of compressed blocks
+			const int blocksX = GetOffsetTableLength(level.Width);
+			const int blocksY = GetOffsetTableLength(level.Height);
+			rows[i].resize(size_t(blocksX) * size_t(blocksY) * size_t(m_BlockBytes));
+			for (int y = 0; y < blocksY; ++y)
+			{
+				for (int x = 0; x < blocksX; ++x)
+				{
+					const uint8_t* pSource = level.pTexels + (level.pOffsetsX[x] + level.pOffsetsY[y]) * m_BlockBytes;
+					std::copy(pSource, pSource + m_BlockBytes, &rows[i][(x + (y * blocksX)) * m_BlockBytes]);
+				}
+			}
+
+			initData[i].pSysMem = rows[i].data();
+			initData[i].SysMemPitch = static_cast<UINT>(blocksX * m_BlockBytes);
+			initData[i].SysMemSlicePitch = static_cast<UINT>(blocksY * blocksX * m_BlockBytes);
+			continue;
+		}
 
-	HRESULT result = pDevice->CreateTexture2D(&desc, &initData, &m_pTexture);
+		rows[i].resize(size_t(level.Width) * size_t(level.Height) * size_t(numChannels));
+		for (int y = 0; y < level.Height; ++y)
+		{
+			for (int x = 0; x < level.Width; ++x)
+			{
+				const uint8_t* pSource = GetTexel(level, x, y);
+				uint8_t* pDestination = &rows[i][(x + (y * level.Width)) * numChannels];
+				for (int c = 0; c < numChannels; ++c)
+					pDestination[c] = pSource[c];
+			}
+		}
+
+		initData[i].pSysMem = rows[i].data();
+		initData[i].SysMemPitch = static_cast<UINT>(level.Width * numChannels);
+		initData[i].SysMemSlicePitch = static_cast<UINT>(level.Height * level.Width * numChannels);
+	}
+
+	HRESULT result = pDevice->CreateTexture2D(&desc, initData.data(), &m_pTexture);
 	if (FAILED(result))
 		return;
 
 	D3D11_SHADER_RESOURCE_VIEW_DESC SRVdesc{};
 	SRVdesc.Format = desc.Format;
 	SRVdesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-	SRVdesc.Texture2D.MipLevels = 1;
+	SRVdesc.Texture2D.MipLevels = desc.MipLevels;
 
 	result = pDevice->CreateShaderResourceView(m_pTexture, &SRVdesc, &m_pTextureResourceView);
 	if (FAILED(result))
 		return;
 }
 
-float Texture::RemapUVComponent(float component) const
+bool Texture::LoadTexels(SDL_Surface* pLoadedSurface)
+{
+	if (!pLoadedSurface)
+		return false;
+
+	//Whatever the file holds (24bpp, paletted...), SDL converts it to RGBA bytes in memory order
+	SDL_Surface* pSurface = SDL_ConvertSurfaceFormat(pLoadedSurface, SDL_PIXELFORMAT_RGBA32, 0);
+	SDL_FreeSurface(pLoadedSurface);
+	if (!pSurface)
+		return false;
+
+	MipLevel level{};
+	level.Width = pSurface->w;
+	level.Height = pSurface->h;
+
+	//BC1 would lose the alpha of images that use it (cutouts, particles...), those stay uncompressed
+	if (m_Format == ETextureFormat::BC1)
+	{
+		bool usesAlpha = false;
+		for (int y = 0; y < level.Height && !usesAlpha; ++y)
+		{
+			const uint8_t* pRow = static_cast<const uint8_t*>(pSurface->pixels) + (y * pSurface->pitch);
+			for (int x = 0; x < level.Width && !usesAlpha; ++x)
+				usesAlpha = (pRow[x * 4 + 3] != 255);
+		}
+		if (usesAlpha)
+		{
+			m_Format = ETextureFormat::RGBA8;
+			m_NumChannels = GetNumChannels(m_Format);
+			m_BlockBytes = GetBlockBytes(m_Format);
+		}
+	}
+	m_pTexelData->Texels.resize(size_t(level.Width) * size_t(level.Height) * size_t(m_NumChannels));
+
+	//Single channel maps only keep the red channel
+	uint8_t* pTexels = m_pTexelData->Texels.data();
+	for (int y = 0; y < level.Height; ++y)
+	{
+		const uint8_t* pRow = static_cast<const uint8_t*>(pSurface->pixels) + (y * pSurface->pitch);
+		for (int x = 0; x < level.Width; ++x)
+		{
+			for (int c = 0; c < m_NumChannels; ++c)
+				*pTexels++ = pRow[x * 4 + c];
+		}
+	}
+	SDL_FreeSurface(pSurface);
+
+	m_MipLevels.push_back(level);
+	return true;
+}
+
+void Texture::BuildMipChain()
+{
+	//All levels share one allocation, grow it once so the texel pointers stay valid
+	size_t numTexels = size_t(m_MipLevels[0].Width) * size_t(m_MipLevels[0].Height);
+	for (int w = m_MipLevels[0].Width, h = m_MipLevels[0].Height; w > 1 || h > 1; )
+	{
+		w = std::max(w / 2, 1);
+		h = std::max(h / 2, 1);
+		numTexels += size_t(w) * size_t(h);
+	}
+	m_pTexelData->Texels.resize(numTexels * size_t(m_NumChannels));
+
+	MipLevel level = m_MipLevels[0];
+	level.pTexels = m_pTexelData->Texels.data();
+	m_MipLevels[0] = level;
+
+	size_t offset = size_t(level.Width) * size_t(level.Height) * size_t(m_NumChannels);
+	while (level.Width > 1 || level.Height > 1)
+	{
+		const MipLevel previous = level;
+		level.Width = std::max(previous.Width / 2, 1);
+		level.Height = std::max(previous.Height / 2, 1);
+		uint8_t* pTexels = &m_pTexelData->Texels[offset];
+		level.pTexels = pTexels;
+		offset += size_t(level.Width) * size_t(level.Height) * size_t(m_NumChannels);
+
+		//Box filter per channel, the last row/column of an odd sized level gets skipped like on the GPU
+		for (int y = 0; y < level.Height; ++y)
+		{
+			for (int x = 0; x < level.Width; ++x)
+			{
+				for (int c = 0; c < m_NumChannels; ++c)
+				{
+					uint32_t sum = 0;
+					for (int i = 0; i < 4; ++i)
+					{
+						const int sourceX = std::min(x * 2 + (i & 1), previous.Width - 1);
+						const int sourceY = std::min(y * 2 + (i >> 1), previous.Height - 1);
+						sum += previous.pTexels[(sourceX + (sourceY * previous.Width)) * m_NumChannels + c];
+					}
+					pTexels[(x + (y * level.Width)) * m_NumChannels + c] = uint8_t((sum + 2) / 4);
+				}
+			}
+		}
+		m_MipLevels.push_back(level);
+	}
+}
+
+/* Spreads the bits of the value apart, a zero bit between every 2 bits of the value */
+static uint32_t SpreadBits(uint32_t value)
+{
+	uint32_t result = 0;
+	for (uint32_t bit = 0; (value >> bit) != 0; ++bit)
+		result |= ((value >> bit) & 1) << (2 * bit);
+	return result;
+}
+
+void Texture::TileMipChain()
+{
+	static const int blockMask = TEXTURE_BLOCK_SIZE - 1;
+	static const int blockArea = TEXTURE_BLOCK_SIZE * TEXTURE_BLOCK_SIZE;
+
+	//Offset tables and texels of all levels in 1 allocation each, sized up front so the pointers stay valid
+	size_t numOffsets = 0;
+	size_t numTexels = 0;
+	for (const MipLevel& level : m_MipLevels)
+	{
+		numOffsets += size_t(level.Width) + size_t(level.Height);
+		const size_t blocksX = size_t((level.Width + blockMask) / TEXTURE_BLOCK_SIZE);
+		const size_t blocksY = size_t((level.Height + blockMask) / TEXTURE_BLOCK_SIZE);
+		numTexels += blocksX * blocksY * blockArea;
+	}
+	m_pTexelData->TexelOffsets.resize(numOffsets);
+	std::vector<uint8_t> tiledTexels(numTexels * size_t(m_NumChannels));
+
+	uint32_t* pOffsets = m_pTexelData->TexelOffsets.data();
+	uint8_t* pTiledTexels = tiledTexels.data();
+	for (MipLevel& level : m_MipLevels)
+	{
+		const uint32_t blocksX = uint32_t((level.Width + blockMask) / TEXTURE_BLOCK_SIZE);
+		const uint32_t blocksY = uint32_t((level.Height + blockMask) / TEXTURE_BLOCK_SIZE);
+
+		//x takes the even bits inside of a block, y the odd bits
+		uint32_t* pOffsetsX = pOffsets;
+		uint32_t* pOffsetsY = pOffsets + level.Width;
+		pOffsets += level.Width + level.Height;
+		for (int x = 0; x < level.Width; ++x)
+			pOffsetsX[x] = uint32_t(x / TEXTURE_BLOCK_SIZE) * blockArea + SpreadBits(uint32_t(x & blockMask));
+		for (int y = 0; y < level.Height; ++y)
+			pOffsetsY[y] = uint32_t(y / TEXTURE_BLOCK_SIZE) * blocksX * blockArea + (SpreadBits(uint32_t(y & blockMask)) << 1);
+
+		for (int y = 0; y < level.Height; ++y)
+		{
+			for (int x = 0; x < level.Width; ++x)
+			{
+				const uint8_t* pSource = level.pTexels + (x + (y * level.Width)) * m_NumChannels;
+				uint8_t* pDestination = pTiledTexels + (pOffsetsX[x] + pOffsetsY[y]) * m_NumChannels;
+				for (int c = 0; c < m_NumChannels; ++c)
+					pDestination[c] = pSource[c];
+			}
+		}
+
+		level.pTexels = pTiledTexels;
+		level.pOffsetsX = pOffsetsX;
+		level.pOffsetsY = pOffsetsY;
+		pTiledTexels += blocksX * blocksY * blockArea * m_NumChannels;
+	}
+	m_pTexelData->Texels.swap(tiledTexels);
+
+	m_pTexelData->pTexels = m_pTexelData->Texels.data();
+	m_pTexelData->NumTexelBytes = m_pTexelData->Texels.size();
+	m_pTexelData->pOffsets = m_pTexelData->TexelOffsets.data();
+	m_pTexelData->NumOffsets = m_pTexelData->TexelOffsets.size();
+}
+
+size_t Texture::GetNumLevelElements(int width, int height) const
+{
+	static const int blockMask = TEXTURE_BLOCK_SIZE - 1;
+	static const int compressedBlocksPerSide = TEXTURE_BLOCK_SIZE / COMPRESSED_BLOCK_SIZE;
+
+	//A block holds 8x8 texels or 2x2 compressed blocks
+	const size_t blocksX = size_t((width + blockMask) / TEXTURE_BLOCK_SIZE);
+	const size_t blocksY = size_t((height + blockMask) / TEXTURE_BLOCK_SIZE);
+	const size_t elementsPerBlock = m_BlockBytes ? size_t(compressedBlocksPerSide * compressedBlocksPerSide) : size_t(TEXTURE_BLOCK_SIZE * TEXTURE_BLOCK_SIZE);
+	return blocksX * blocksY * elementsPerBlock;
+}
+
+/* 16 texels of a compressed block, row by row, all 4 channels */
+using BlockTexels = uint8_t[16][4];
+
+/* Expands a 5:6:5 color to 8 bits per channel */
+static void FromRGB565(uint16_t color, uint8_t* pRGB)
+{
+	const uint32_t r = (color >> 11) & 31;
+	const uint32_t g = (color >> 5) & 63;
+	const uint32_t b = color & 31;
+	pRGB[0] = uint8_t((r << 3) | (r >> 2));
+	pRGB[1] = uint8_t((g << 2) | (g >> 4));
+	pRGB[2] = uint8_t((b << 3) | (b >> 2));
+}
+
+/* Rounds an 8 bits per channel color to 5:6:5 */
+static uint16_t ToRGB565(int r, int g, int b)
+{
+	return uint16_t((((r * 31 + 127) / 255) << 11) | (((g * 63 + 127) / 255) << 5) | ((b * 31 + 127) / 255));
+}
+
+/* Returns the 4 RGBA8 colors the indices of a BC1 block pick from */
+static void GetBC1Palette(uint16_t color0, uint16_t color1, uint8_t (&palette)[4][4])
+{
+	FromRGB565(color0, palette[0]);
+	FromRGB565(color1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+
+	//Color0 <= color1 is the 3 color mode, the last color is transparent black
+	const bool hasFourColors = (color0 > color1);
+	for (int c = 0; c < 3; ++c)
+	{
+		if (hasFourColors)
+		{
+			palette[2][c] = uint8_t((2 * palette[0][c] + palette[1][c] + 1) / 3);
+			palette[3][c] = uint8_t((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+		}
+		else
+		{
+			palette[2][c] = uint8_t((palette[0][c] + palette[1][c] + 1) / 2);
+			palette[3][c] = 0;
+		}
+	}
+	if (!hasFourColors)
+		palette[3][3] = 0;
+}
+
+/* Encodes the rgb channels of the texels into a BC1 block (opaque, 4 color mode) */
+static void EncodeBC1Block(const BlockTexels& texels, uint8_t* pBlock)
+{
+	//Bounding box of the colors
+	int minColor[3] = { 255, 255, 255 };
+	int maxColor[3] = { 0, 0, 0 };
+	int sum[3] = {};
+	for (const uint8_t* pTexel : texels)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			minColor[c] = std::min(minColor[c], int(pTexel[c]));
+			maxColor[c] = std::max(maxColor[c], int(pTexel[c]));
+			sum[c] += pTexel[c];
+		}
+	}
+
+	//The endpoints lie on the diagonal of the box that follows the colors: a channel that falls while the widest one rises gets flipped
+	int widest = 0;
+	for (int c = 1; c < 3; ++c)
+	{
+		if (maxColor[c] - minColor[c] > maxColor[widest] - minColor[widest])
+			widest = c;
+	}
+	for (int c = 0; c < 3; ++c)
+	{
+		int covariance = 0; //Times 16 * 16, the mean is sum / 16
+		for (const uint8_t* pTexel : texels)
+			covariance += (pTexel[widest] * 16 - sum[widest]) * (pTexel[c] * 16 - sum[c]);
+		if (covariance < 0)
+			std::swap(minColor[c], maxColor[c]);
+
+		//Inset by 1/16 of the range, the extremes are mostly outliers
+		const int inset = (maxColor[c] - minColor[c]) / 16;
+		maxColor[c] -= inset;
+		minColor[c] += inset;
+	}
+
+	uint16_t color0 = ToRGB565(maxColor[0], maxColor[1], maxColor[2]);
+	uint16_t color1 = ToRGB565(minColor[0], minColor[1], minColor[2]);
+	if (color0 < color1)
+		std::swap(color0, color1);
+
+	//Nearest palette color per texel, a single color block (color0 == color1) only uses index 0
+	uint8_t palette[4][4]{};
+	GetBC1Palette(color0, color1, palette);
+	const int numColors = (color0 > color1) ? 4 : 1;
+	uint32_t indices = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		int bestIndex = 0;
+		int bestDistance = INT_MAX;
+		for (int p = 0; p < numColors; ++p)
+		{
+			const int distance = Elite::Square(texels[i][0] - palette[p][0]) + Elite::Square(texels[i][1] - palette[p][1]) + Elite::Square(texels[i][2] - palette[p][2]);
+			if (distance < bestDistance)
+			{
+				bestDistance = distance;
+				bestIndex = p;
+			}
+		}
+		indices |= uint32_t(bestIndex) << (2 * i);
+	}
+
+	pBlock[0] = uint8_t(color0);
+	pBlock[1] = uint8_t(color0 >> 8);
+	pBlock[2] = uint8_t(color1);
+	pBlock[3] = uint8_t(color1 >> 8);
+	for (int b = 0; b < 4; ++b)
+		pBlock[4 + b] = uint8_t(indices >> (8 * b));
+}
+
+/* Decodes a BC1 block into 16 RGBA8 texels */
+static void DecodeBC1Block(const uint8_t* pBlock, uint8_t* pTexels)
+{
+	uint8_t palette[4][4]{};
+	GetBC1Palette(uint16_t(pBlock[0] | (pBlock[1] << 8)), uint16_t(pBlock[2] | (pBlock[3] << 8)), palette);
+	const uint32_t indices = uint32_t(pBlock[4]) | (uint32_t(pBlock[5]) << 8) | (uint32_t(pBlock[6]) << 16) | (uint32_t(pBlock[7]) << 24);
+	for (int i = 0; i < 16; ++i)
+	{
+		const uint8_t* pColor = palette[(indices >> (2 * i)) & 3];
+		std::copy(pColor, pColor + 4, pTexels + i * 4);
+	}
+}
+
+/* Encodes a channel of the texels into a BC4 block (8 value mode, between the lowest and highest value) */
+static void EncodeBC4Block(const BlockTexels& texels, int channel, uint8_t* pBlock)
+{
+	int minValue = 255;
+	int maxValue = 0;
+	for (const uint8_t* pTexel : texels)
+	{
+		minValue = std::min(minValue, int(pTexel[channel]));
+		maxValue = std::max(maxValue, int(pTexel[channel]));
+	}
+
+	//Index 0 is the highest value, 1 the lowest and 2-7 are the steps from high to low in between
+	uint64_t indices = 0;
+	const int range = maxValue - minValue;
+	if (range > 0)
+	{
+		for (int i = 0; i < 16; ++i)
+		{
+			const int step = ((maxValue - texels[i][channel]) * 14 + range) / (range * 2); //Rounded 7ths from high to low
+			const uint64_t index = (step == 0) ? 0 : (step == 7) ? 1 : uint64_t(step + 1);
+			indices |= index << (3 * i);
+		}
+	}
+
+	pBlock[0] = uint8_t(maxValue);
+	pBlock[1] = uint8_t(minValue);
+	for (int b = 0; b < 6; ++b)
+		pBlock[2 + b] = uint8_t(indices >> (8 * b));
+}
+
+/* Decodes a BC4 block into the given channel of 16 RGBA8 texels */
+static void DecodeBC4Block(const uint8_t* pBlock, uint8_t* pTexels, int channel)
 {
-	if (component < 0.f)
-		return RemapUVComponent(component + 1);
+	const int value0 = pBlock[0];
+	const int value1 = pBlock[1];
+	int palette[8] = { value0, value1 };
+	if (value0 > value1)
+	{
+		for (int i = 1; i < 7; ++i)
+			palette[i + 1] = ((7 - i) * value0 + i * value1 + 3) / 7;
+	}
+	else
+	{
+		for (int i = 1; i < 5; ++i)
+			palette[i + 1] = ((5 - i) * value0 + i * value1 + 2) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
 
-	else if (component > 1.f)
-		return RemapUVComponent(component - 1);
+	uint64_t indices = 0;
+	for (int b = 0; b < 6; ++b)
+		indices |= uint64_t(pBlock[2 + b]) << (8 * b);
+	for (int i = 0; i < 16; ++i)
+		pTexels[i * 4 + channel] = uint8_t(palette[(indices >> (3 * i)) & 7]);
+}
+
+void Texture::CompressMipChain()
+{
+	static const int compressedBlocksPerSide = TEXTURE_BLOCK_SIZE / COMPRESSED_BLOCK_SIZE;
+	static const int compressedBlocksPerBlock = compressedBlocksPerSide * compressedBlocksPerSide;
+
+	//Offset tables and compressed blocks of all levels in 1 allocation each, sized up front so the pointers stay valid
+	size_t numOffsets = 0;
+	size_t numCompressedBlocks = 0;
+	for (const MipLevel& level : m_MipLevels)
+	{
+		numOffsets += size_t(GetOffsetTableLength(level.Width)) + size_t(GetOffsetTableLength(level.Height));
+		numCompressedBlocks += GetNumLevelElements(level.Width, level.Height);
+	}
+	m_pTexelData->TexelOffsets.resize(numOffsets);
+	std::vector<uint8_t> compressedTexels(numCompressedBlocks * size_t(m_BlockBytes));
+
+	uint32_t* pOffsets = m_pTexelData->TexelOffsets.data();
+	uint8_t* pCompressedTexels = compressedTexels.data();
+	for (MipLevel& level : m_MipLevels)
+	{
+		const int compressedBlocksX = GetOffsetTableLength(level.Width);
+		const int compressedBlocksY = GetOffsetTableLength(level.Height);
+		const uint32_t blocksX = uint32_t((compressedBlocksX + compressedBlocksPerSide - 1) / compressedBlocksPerSide);
+
+		//Same interleaving as TileMipChain, on compressed blocks instead of texels
+		uint32_t* pOffsetsX = pOffsets;
+		uint32_t* pOffsetsY = pOffsets + compressedBlocksX;
+		pOffsets += compressedBlocksX + compressedBlocksY;
+		for (int x = 0; x < compressedBlocksX; ++x)
+			pOffsetsX[x] = uint32_t(x / compressedBlocksPerSide) * compressedBlocksPerBlock + SpreadBits(uint32_t(x % compressedBlocksPerSide));
+		for (int y = 0; y < compressedBlocksY; ++y)
+			pOffsetsY[y] = uint32_t(y / compressedBlocksPerSide) * blocksX * compressedBlocksPerBlock + (SpreadBits(uint32_t(y % compressedBlocksPerSide)) << 1);
+
+		for (int y = 0; y < compressedBlocksY; ++y)
+		{
+			for (int x = 0; x < compressedBlocksX; ++x)
+			{
+				//Compressed blocks sticking out of the level repeat its last row/column
+				BlockTexels texels{};
+				for (int i = 0; i < 16; ++i)
+				{
+					const int sourceX = std::min(x * COMPRESSED_BLOCK_SIZE + (i % COMPRESSED_BLOCK_SIZE), level.Width - 1);
+					const int sourceY = std::min(y * COMPRESSED_BLOCK_SIZE + (i / COMPRESSED_BLOCK_SIZE), level.Height - 1);
+					const uint8_t* pSource = level.pTexels + (sourceX + (sourceY * level.Width)) * m_NumChannels;
+					std::copy(pSource, pSource + m_NumChannels, texels[i]);
+				}
+
+				uint8_t* pBlock = pCompressedTexels + (pOffsetsX[x] + pOffsetsY[y]) * m_BlockBytes;
+				switch (m_Format)
+				{
+				case ETextureFormat::BC1:
+					EncodeBC1Block(texels, pBlock);
+					break;
+				case ETextureFormat::BC4:
+					EncodeBC4Block(texels, 0, pBlock);
+					break;
+				case ETextureFormat::BC5:
+				default:
+					EncodeBC4Block(texels, 0, pBlock);
+					EncodeBC4Block(texels, 1, pBlock + 8);
+					break;
+				}
+			}
+		}
+
+		level.pTexels = pCompressedTexels;
+		level.pOffsetsX = pOffsetsX;
+		level.pOffsetsY = pOffsetsY;
+		pCompressedTexels += GetNumLevelElements(level.Width, level.Height) * m_BlockBytes;
+	}
+	m_pTexelData->Texels.swap(compressedTexels);
+
+	m_pTexelData->pTexels = m_pTexelData->Texels.data();
+	m_pTexelData->NumTexelBytes = m_pTexelData->Texels.size();
+	m_pTexelData->pOffsets = m_pTexelData->TexelOffsets.data();
+	m_pTexelData->NumOffsets = m_pTexelData->TexelOffsets.size();
+}
+
+void Texture::DecodeBlock(const uint8_t* pBlock, uint8_t* pTexels) const
+{
+	switch (m_Format)
+	{
+	case ETextureFormat::BC1:
+		DecodeBC1Block(pBlock, pTexels);
+		break;
+	case ETextureFormat::BC4:
+		DecodeBC4Block(pBlock, pTexels, 0);
+		for (int i = 0; i < 16; ++i)
+		{
+			pTexels[i * 4 + 1] = pTexels[i * 4 + 2] = pTexels[i * 4];
+			pTexels[i * 4 + 3] = 255;
+		}
+		break;
+	case ETextureFormat::BC5:
+	default:
+		//Unit length normal, z points out of the surface
+		DecodeBC4Block(pBlock, pTexels, 0);
+		DecodeBC4Block(pBlock + 8, pTexels, 1);
+		for (int i = 0; i < 16; ++i)
+		{
+			const float x = s_UNormToFloat[pTexels[i * 4]] * 2.f - 1.f;
+			const float y = s_UNormToFloat[pTexels[i * 4 + 1]] * 2.f - 1.f;
+			const float z = sqrtf(std::max(1.f - x * x - y * y, 0.f));
+			pTexels[i * 4 + 2] = uint8_t((z * 0.5f + 0.5f) * 255.f + 0.5f);
+			pTexels[i * 4 + 3] = 255;
+		}
+		break;
+	}
+}
+
+const uint8_t* Texture::GetTexel(const MipLevel& level, int x, int y) const
+{
+	if (!m_BlockBytes)
+		return level.pTexels + (level.pOffsetsX[x] + level.pOffsetsY[y]) * m_NumChannels;
+
+	const unsigned blockX = unsigned(x) / COMPRESSED_BLOCK_SIZE;
+	const unsigned blockY = unsigned(y) / COMPRESSED_BLOCK_SIZE;
+	const uint8_t* pBlock = level.pTexels + (level.pOffsetsX[blockX] + level.pOffsetsY[blockY]) * m_BlockBytes;
+
+	//Hash of the block address picks the entry, the id of the texels keeps blocks of freed textures from matching
+	const uint64_t address = uint64_t(reinterpret_cast<uintptr_t>(pBlock));
+	DecodedBlock& decodedBlock = s_DecodedBlocks[uint32_t((address >> 3) * 0x9E3779B1u) >> (32 - DECODED_BLOCK_CACHE_BITS)];
+	if (decodedBlock.pBlock != pBlock || decodedBlock.TexelDataId != m_pTexelData->Id)
+	{
+		DecodeBlock(pBlock, decodedBlock.Texels);
+		decodedBlock.pBlock = pBlock;
+		decodedBlock.TexelDataId = m_pTexelData->Id;
+	}
+
+	const unsigned texelX = unsigned(x) % COMPRESSED_BLOCK_SIZE;
+	const unsigned texelY = unsigned(y) % COMPRESSED_BLOCK_SIZE;
+	return decodedBlock.Texels + (texelX + texelY * COMPRESSED_BLOCK_SIZE) * 4;
+}
+
+/* Converts a texel coordinate to an integer, limited to a range where the conversion is defined (NaN ends up at the upper limit)
+	Further out than 2^24 texels a float can't tell texels apart anyway */
+static inline int ToTexelCoordinate(float coordinate)
+{
+	static const float limit = float(1 << 24);
+	return int(std::max(-limit, std::min(limit, coordinate)));
+}
+
+/* Moves the texel coordinate inside of [0, size) according to the address mode, border clamps (FetchTexel swaps in the border color) */
+static inline int AddressTexel(int coordinate, int size, ETextureAddressMode addressMode)
+{
+	switch (addressMode)
+	{
+	case ETextureAddressMode::Wrap:
+	default:
+	{
+		const int wrapped = coordinate % size;
+		return wrapped + ((wrapped >> 31) & size); //Remainder is negative for negative coordinates
+	}
+	case ETextureAddressMode::Mirror:
+	{
+		const int period = size * 2;
+		int wrapped = coordinate % period;
+		wrapped += (wrapped >> 31) & period;
+		return std::min(wrapped, period - 1 - wrapped);
+	}
+	case ETextureAddressMode::Clamp:
+	case ETextureAddressMode::Border:
+		return std::min(std::max(coordinate, 0), size - 1);
+	}
+}
+
+Texture::TexelColor Texture::FetchTexel(const MipLevel& level, int x, int y, const TextureSampler& sampler) const
+{
+	const bool isOutside = (unsigned(x) >= unsigned(level.Width)) | (unsigned(y) >= unsigned(level.Height));
+	const bool useBorder = isOutside & (sampler.AddressMode == ETextureAddressMode::Border);
+	x = AddressTexel(x, level.Width, sampler.AddressMode);
+	y = AddressTexel(y, level.Height, sampler.AddressMode);
+
+	const uint8_t* pTexel = GetTexel(level, x, y);
+	TexelColor color{};
+	if ((m_Format == ETextureFormat::R8) || (m_Format == ETextureFormat::BC4))
+	{
+		color.r = color.g = color.b = s_UNormToFloat[pTexel[0]];
+		color.a = 1.f;
+	}
+	else
+	{
+		color.r = s_UNormToFloat[pTexel[0]];
+		color.g = s_UNormToFloat[pTexel[1]];
+		color.b = s_UNormToFloat[pTexel[2]];
+		color.a = s_UNormToFloat[pTexel[3]];
+	}
+
+	TexelColor border{};
+	border.r = sampler.BorderColor.r;
+	border.g = sampler.BorderColor.g;
+	border.b = sampler.BorderColor.b;
+	return useBorder ? border : color;
+}
+
+Texture::TexelColor Texture::SamplePoint(const MipLevel& level, const Elite::FVector2& uv, const TextureSampler& sampler) const
+{
+	return FetchTexel(level, ToTexelCoordinate(floorf(uv.x * level.Width)), ToTexelCoordinate(floorf(uv.y * level.Height)), sampler);
+}
+
+Texture::TexelColor Texture::SampleBilinear(const MipLevel& level, const Elite::FVector2& uv, const TextureSampler& sampler) const
+{
+	//Texel centers lie on half coordinates
+	const float x = uv.x * level.Width - 0.5f;
+	const float y = uv.y * level.Height - 0.5f;
+	const float floorX = floorf(x);
+	const float floorY = floorf(y);
+	const float tx = x - floorX;
+	const float ty = y - floorY;
+	const int x0 = ToTexelCoordinate(floorX);
+	const int y0 = ToTexelCoordinate(floorY);
 
-	return component;
+	const TexelColor top = LerpTexel(FetchTexel(level, x0, y0, sampler), FetchTexel(level, x0 + 1, y0, sampler), tx);
+	const TexelColor bottom = LerpTexel(FetchTexel(level, x0, y0 + 1, sampler), FetchTexel(level, x0 + 1, y0 + 1, sampler), tx);
+	return LerpTexel(top, bottom, ty);
 }
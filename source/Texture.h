@@ -1,15 +1,49 @@
 #pragma once
 #include "EMath.h"
 #include "ERGBColor.h"
+#include "Structs.h"
+#include <vector>
+#include <memory>
 
 struct SDL_Surface;
+class MappedFile;
 struct ID3D11Texture2D;
 struct ID3D11ShaderResourceView;
 
+/* Texel format textures get converted to once at load time, whatever the format of the image file is
+	The block compressed formats get encoded at load time and decoded per 4x4 block when sampled, for a 4-8x cut in texel memory */
+enum class ETextureFormat : unsigned int
+{
+	RGBA8 = 0, //Color maps
+	R8 = 1,    //Single channel maps (gloss, roughness, metalness...), sampling returns the channel in r, g and b
+	BC1 = 2,   //Color maps, 4 bits per texel. Images that use alpha stay RGBA8, BC1 can't keep it
+	BC4 = 3,   //Single channel maps, 4 bits per texel, samples like R8
+	BC5 = 4    //Tangent space normal maps, 8 bits per texel: x and y are stored, sampling reconstructs z in b
+};
+
+class Texture;
+
+/* Where a channel of a packed texture comes from, channels without a texture stay 0 */
+struct TextureChannelSource
+{
+	const Texture* pTexture = nullptr;
+	int Channel = 0; //0 = r, 1 = g, 2 = b, 3 = a
+};
+
 class Texture final
 {
 public:
-	Texture(const char* filepath, ID3D11Device* pDevice);
+	Texture(const char* filepath, ID3D11Device* pDevice, ETextureFormat format = ETextureFormat::RGBA8);
+	/* Decodes an image file that was already read into memory */
+	Texture(const void* pFileData, size_t fileSize, ID3D11Device* pDevice, ETextureFormat format = ETextureFormat::RGBA8);
+	/* Shares the texels of the source texture (nothing gets decoded or copied), only the DX resource gets created for the given device */
+	Texture(const Texture& source, ID3D11Device* pDevice);
+	/* Packs channels of already loaded textures into 1 RGBA8 texture, for the software rasterizer only (no DX resource)
+		All of the source textures need to have the same size and an uncompressed format */
+	explicit Texture(const TextureChannelSource (&channels)[4]);
+	/* Loads a texture written by WriteCacheFile without decoding or copying anything: the levels are sampled straight from the mapped file
+		Takes ownership of the file, has no mip levels if it isn't a valid cache file of the image with the given content hash and format */
+	Texture(MappedFile* pCacheFile, uint64_t contentHash, ID3D11Device* pDevice, ETextureFormat format);
 	Texture(const Texture& l) = delete;
 	Texture(Texture&& l) = delete;
 	Texture& operator=(const Texture& l) = delete;
@@ -19,19 +53,137 @@ public:
 	/* Returns pointer to texture resource view */
 	ID3D11ShaderResourceView* GetTextureResourceView() const { return m_pTextureResourceView; }
 
-	/* Samples and returns a color [0,1] from the stored texture at the given UV-coordinate */
-	Elite::RGBColor Sample(const Elite::FVector2& uv) const;
+	/* Samples and returns a color [0,1] at the given UV-coordinate, the UV derivatives (per pixel) decide which mip level(s) get used
+		Costs the same for any UV-coordinate, huge and NaN coordinates included */
+	Elite::RGBColor Sample(const Elite::FVector2& uv, const Elite::FVector2& uvDerivativeX, const Elite::FVector2& uvDerivativeY, const TextureSampler& sampler) const;
+
+	/* Same as above, also returns the alpha channel (used by packed textures) */
+	Elite::RGBColor Sample(const Elite::FVector2& uv, const Elite::FVector2& uvDerivativeX, const Elite::FVector2& uvDerivativeY, const TextureSampler& sampler, float& alpha) const;
+
+	/* Returns size of the full resolution level */
+	int GetWidth() const { return m_MipLevels.empty() ? 0 : m_MipLevels[0].Width; }
+	int GetHeight() const { return m_MipLevels.empty() ? 0 : m_MipLevels[0].Height; }
+
+	/* Returns amount of memory the texels of the software rasterizer take, shared with other textures or not */
+	size_t GetTexelBytes() const;
+
+	/* Returns true if both textures sample the same texels */
+	bool SharesTexels(const Texture& other) const { return m_pTexelData == other.m_pTexelData; }
+
+	/* Returns format the texels are stored in */
+	ETextureFormat GetFormat() const { return m_Format; }
+
+	/* Returns true if the texels are stored in 4x4 blocks of a block compressed format */
+	bool IsBlockCompressed() const { return m_BlockBytes != 0; }
+
+	/* Returns amount of mip levels, full resolution included */
+	uint32_t GetNumMipLevels() const { return uint32_t(m_MipLevels.size()); }
+
+	/* Writes the levels in the layout they're sampled in, so the texture can be mapped back in by another run (or process)
+		The file gets swapped in at once, nobody maps a half written file. Returns false if it couldn't be written (or replaced) */
+	bool WriteCacheFile(const char* filepath, uint64_t contentHash) const;
 
 private:
-	SDL_Surface* m_pSurface;
+	/* Texels of a single mip level, stored in blocks of 8x8 texels with Morton (Z) order inside of a block, blocks row by row
+		A bilinear footprint or a short walk in any direction stays in 1 block, where row by row storage would touch a cache line per row
+		Index of texel (x, y) = OffsetsX[x] + OffsetsY[y], the interleaving of the coordinate bits is precomputed per level
+		Block compressed levels have the same layout with 2x2 compressed blocks per 8x8 texels: index of the compressed block = OffsetsX[x / 4] + OffsetsY[y / 4] */
+	struct MipLevel
+	{
+		int Width = 0;
+		int Height = 0;
+		const uint8_t* pTexels = nullptr;
+		const uint32_t* pOffsetsX = nullptr;
+		const uint32_t* pOffsetsY = nullptr;
+	};
+
+	/* Filtered texel, all 4 channels */
+	struct TexelColor
+	{
+		float r = 0.f;
+		float g = 0.f;
+		float b = 0.f;
+		float a = 0.f;
+	};
+
+	//Texels per side of a block, 8x8 RGBA8 texels are 4 cache lines
+	static const int TEXTURE_BLOCK_SIZE = 8;
+
+	//Texels per side of a compressed block
+	static const int COMPRESSED_BLOCK_SIZE = 4;
+
+	//Only change at load time, when BC1 falls back to RGBA8
+	ETextureFormat m_Format;
+	int m_NumChannels; //Bytes per texel, before compression for the block compressed formats
+	int m_BlockBytes;  //Bytes per compressed block, 0 when uncompressed
 	ID3D11Texture2D* m_pTexture;
 	ID3D11ShaderResourceView* m_pTextureResourceView;
+	std::vector<MipLevel> m_MipLevels;
+
+	/* Storage of the levels, the image file itself isn't kept around
+		Never changed once loaded, so textures of other devices can share it */
+	struct TexelData
+	{
+		TexelData();
+		~TexelData();
+		TexelData(const TexelData& t) = delete;
+		TexelData& operator=(const TexelData& t) = delete;
+
+		//Texels and offset tables (of all levels) the levels point into, either the vectors or the mapped cache file
+		const uint8_t* pTexels = nullptr;
+		size_t NumTexelBytes = 0;
+		const uint32_t* pOffsets = nullptr;
+		size_t NumOffsets = 0;
+
+		std::vector<uint8_t> Texels;
+		std::vector<uint32_t> TexelOffsets;
+		MappedFile* pCacheFile = nullptr; //Owned
+
+		const uint64_t Id; //Unique for the lifetime of the process, tells decoded blocks apart when freed texels get reallocated
+	};
+	std::shared_ptr<TexelData> m_pTexelData;
+
+	/* Builds the texels and the DX resources from the loaded image (which gets freed) */
+	void Initialize(SDL_Surface* pLoadedSurface, ID3D11Device* pDevice);
+
+	/* Initializes the DX texture and shader resource view from the mip chain */
+	void InitializeResources(ID3D11Device* pDevice);
+
+	/* Converts the loaded image to the texel format and frees it, returns false if it couldn't be loaded */
+	bool LoadTexels(SDL_Surface* pLoadedSurface);
+
+	/* Builds the mip chain down to 1x1 texel at load time, every texel is the average of the 2x2 texels above it */
+	void BuildMipChain();
+
+	/* Rearranges the texels of every level from row by row into blocks, the sides of a level get padded to a multiple of the block size */
+	void TileMipChain();
+
+	/* Encodes every level into compressed blocks, in the same block layout as TileMipChain */
+	void CompressMipChain();
+
+	/* Returns amount of entries of the offset table of a level side of the given size */
+	int GetOffsetTableLength(int size) const { return m_BlockBytes ? (size + COMPRESSED_BLOCK_SIZE - 1) / COMPRESSED_BLOCK_SIZE : size; }
+
+	/* Returns amount of texels (or compressed blocks) a level of the given size stores, padding included */
+	size_t GetNumLevelElements(int width, int height) const;
+
+	/* Returns bytes per stored texel (or compressed block) */
+	int GetElementBytes() const { return m_BlockBytes ? m_BlockBytes : m_NumChannels; }
+
+	/* Returns the bytes of the texel, 4 (RGBA8) for the block compressed formats, which get decoded through a small cache per thread
+		The pointer stays valid until the next call on the same thread */
+	const uint8_t* GetTexel(const MipLevel& level, int x, int y) const;
+
+	/* Decodes a compressed block into 4x4 RGBA8 texels, row by row */
+	void DecodeBlock(const uint8_t* pBlock, uint8_t* pTexels) const;
+
+	/* Returns the color of the texel, coordinates outside of the level are resolved by the address mode */
+	TexelColor FetchTexel(const MipLevel& level, int x, int y, const TextureSampler& sampler) const;
 
-	/* Initializes the DX texture and shader resource view, given a filepath to a textre */
-	void Initialize(const char* filepath, ID3D11Device* pDevice);
+	TexelColor SamplePoint(const MipLevel& level, const Elite::FVector2& uv, const TextureSampler& sampler) const;
+	TexelColor SampleBilinear(const MipLevel& level, const Elite::FVector2& uv, const TextureSampler& sampler) const;
 
-	/* Recursive function that remaps the UV-coordinates between [0, 1] in case they become out of range
-	-> Uses wrap addressing mode to achieve this */
-	float RemapUVComponent(float component) const;
+	/* Linear interpolation of all 4 channels */
+	static TexelColor LerpTexel(const TexelColor& c0, const TexelColor& c1, float t);
 };
 
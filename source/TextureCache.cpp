@@ -0,0 +1,256 @@
+#pragma once
+#include "pch.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
+#include "MappedFile.h"
+#include <fstream>
+#include <cctype>
+#include <cstdlib>
+#include <cstdio>
+
+TextureCache::TextureCache()
+	: m_pLoaderPool(new ThreadPool())
+	, m_NumMapped(0)
+{
+	SetDiskCacheDirectory("./Resources/TextureCache");
+}
+
+TextureCache::~TextureCache()
+{
+	//Finishes the textures that are still loading
+	delete m_pLoaderPool;
+
+	//Textures that weren't released by their owners
+	for (Entry& entry : m_Entries)
+		delete entry.Future.get();
+}
+
+TextureCache& TextureCache::GetInstance()
+{
+	static TextureCache cache{};
+	return cache;
+}
+
+const Texture* TextureCache::Acquire(const char* filepath, ID3D11Device* pDevice, ETextureFormat format)
+{
+	return AcquireAsync(filepath, pDevice, format).get();
+}
+
+std::shared_future<const Texture*> TextureCache::AcquireAsync(const char* filepath, ID3D11Device* pDevice, ETextureFormat format)
+{
+	std::lock_guard<std::recursive_mutex> lock{ m_Mutex };
+
+	//Files that were seen before don't need to be read to know their content
+	const std::string canonicalPath = GetCanonicalPath(filepath);
+	auto pFileData = std::make_shared<std::vector<uint8_t>>();
+	auto hashIt = m_ContentHashes.find(canonicalPath);
+	if (hashIt == m_ContentHashes.end())
+	{
+		if (!ReadFile(canonicalPath, *pFileData))
+			return MakeReadyFuture(nullptr);
+		hashIt = m_ContentHashes.emplace(canonicalPath, HashContent(*pFileData)).first;
+	}
+	const uint64_t contentHash = hashIt->second;
+
+	//Already loaded (or loading) for this device
+	if (Entry* pEntry = FindEntry(contentHash, format, pDevice))
+	{
+		++pEntry->RefCount;
+		++m_NumHits;
+		return pEntry->Future;
+	}
+
+	Entry entry{};
+	entry.ContentHash = contentHash;
+	entry.Format = format;
+	entry.pDevice = pDevice;
+	entry.RefCount = 1;
+	if (Entry* pOtherDevice = FindEntry(contentHash, format, nullptr))
+	{
+		//Already loaded for another device, only the DX resource is missing
+		//Waiting on a task that was queued earlier can't deadlock, the queue runs oldest first
+		//The task holds a reference on the source, so its owner releasing it in the meantime doesn't delete it
+		++pOtherDevice->RefCount;
+		std::shared_future<const Texture*> source = pOtherDevice->Future;
+		entry.Future = m_pLoaderPool->Submit([this, source, pDevice]() -> const Texture*
+		{
+			const Texture* pSource = source.get();
+			const Texture* pTexture = pSource ? new Texture(*pSource, pDevice) : nullptr;
+			Release(pSource);
+			return pTexture;
+		}).share();
+		++m_NumHits;
+	}
+	else
+	{
+		//Decoded before (by any run or process), mapping the disk cache file skips reading and decoding the image file
+		const std::string cacheFilepath = GetDiskCacheFilepath(contentHash, format);
+
+		//Decoding, conversion, mip generation and tiling on a loader thread (the device is free threaded, so is the DX upload)
+		std::atomic<uint64_t>* pNumMapped = &m_NumMapped;
+		entry.Future = m_pLoaderPool->Submit([pFileData, canonicalPath, cacheFilepath, contentHash, pDevice, format, pNumMapped]() -> const Texture*
+		{
+			if (!cacheFilepath.empty())
+			{
+				Texture* pMappedTexture = new Texture(new MappedFile(cacheFilepath.c_str()), contentHash, pDevice, format);
+				if (pMappedTexture->GetNumMipLevels() != 0)
+				{
+					++*pNumMapped;
+					return pMappedTexture;
+				}
+				delete pMappedTexture;
+			}
+
+			if (pFileData->empty() && !ReadFile(canonicalPath, *pFileData))
+				return nullptr;
+
+			Texture* pTexture = new Texture(pFileData->data(), pFileData->size(), pDevice, format);
+			if (pTexture->GetNumMipLevels() == 0) //Not an image SDL_image can decode
+			{
+				delete pTexture;
+				return nullptr;
+			}
+
+			//Failing to write only costs the next run a decode
+			if (!cacheFilepath.empty())
+				pTexture->WriteCacheFile(cacheFilepath.c_str(), contentHash);
+			return pTexture;
+		}).share();
+		++m_NumMisses;
+	}
+	m_Entries.push_back(entry);
+	return entry.Future;
+}
+
+void TextureCache::Release(const Texture* pTexture)
+{
+	if (!pTexture)
+		return;
+
+	std::lock_guard<std::recursive_mutex> lock{ m_Mutex };
+	for (size_t i = 0; i < m_Entries.size(); ++i)
+	{
+		//The owner got the texture out of the future, so it's loaded
+		if (!IsLoaded(m_Entries[i]) || m_Entries[i].Future.get() != pTexture)
+			continue;
+
+		if (--m_Entries[i].RefCount == 0)
+		{
+			delete pTexture;
+			m_Entries[i] = m_Entries.back();
+			m_Entries.pop_back();
+		}
+		return;
+	}
+}
+
+TextureCacheStats TextureCache::GetStats() const
+{
+	std::lock_guard<std::recursive_mutex> lock{ m_Mutex };
+	TextureCacheStats stats{};
+	stats.NumHits = m_NumHits;
+	stats.NumMisses = m_NumMisses;
+	stats.NumMapped = m_NumMapped;
+	stats.NumTextures = uint32_t(m_Entries.size());
+	for (size_t i = 0; i < m_Entries.size(); ++i)
+	{
+		if (!IsLoaded(m_Entries[i]))
+		{
+			++stats.NumLoading;
+			continue;
+		}
+
+		const Texture* pTexture = m_Entries[i].Future.get();
+		if (!pTexture)
+			continue;
+
+		//Texels of another device's texture were already counted
+		bool isShared = false;
+		for (size_t j = 0; j < i && !isShared; ++j)
+			isShared = IsLoaded(m_Entries[j]) && m_Entries[j].Future.get() && pTexture->SharesTexels(*m_Entries[j].Future.get());
+
+		if (!isShared)
+			stats.ResidentBytes += pTexture->GetTexelBytes();
+	}
+	return stats;
+}
+
+void TextureCache::SetDiskCacheDirectory(const std::string& directory)
+{
+	m_DiskCacheDirectory = directory;
+	if (!m_DiskCacheDirectory.empty())
+		CreateDirectoryA(m_DiskCacheDirectory.c_str(), nullptr); //Fails harmlessly if it already exists
+}
+
+std::string TextureCache::GetDiskCacheFilepath(uint64_t contentHash, ETextureFormat format) const
+{
+	if (m_DiskCacheDirectory.empty())
+		return std::string{};
+
+	//Content hash and format in the name, a different image or format never finds the file
+	char filename[64]{};
+	snprintf(filename, sizeof(filename), "/%016llx_%u.tex", static_cast<unsigned long long>(contentHash), static_cast<unsigned int>(format));
+	return m_DiskCacheDirectory + filename;
+}
+
+bool TextureCache::IsLoaded(const Entry& entry)
+{
+	return entry.Future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+std::shared_future<const Texture*> TextureCache::MakeReadyFuture(const Texture* pTexture)
+{
+	std::promise<const Texture*> promise{};
+	promise.set_value(pTexture);
+	return promise.get_future().share();
+}
+
+TextureCache::Entry* TextureCache::FindEntry(uint64_t contentHash, ETextureFormat format, const ID3D11Device* pDevice)
+{
+	for (Entry& entry : m_Entries)
+	{
+		if (entry.ContentHash == contentHash && entry.Format == format && (!pDevice || entry.pDevice == pDevice))
+			return &entry;
+	}
+	return nullptr;
+}
+
+bool TextureCache::ReadFile(const std::string& filepath, std::vector<uint8_t>& data)
+{
+	std::ifstream file(filepath, std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+
+	const std::streamsize size = file.tellg();
+	if (size <= 0)
+		return false;
+
+	data.resize(size_t(size));
+	file.seekg(0, std::ios::beg);
+	return bool(file.read(reinterpret_cast<char*>(data.data()), size));
+}
+
+std::string TextureCache::GetCanonicalPath(const char* filepath)
+{
+	//Windows paths aren't case sensitive and take both separators
+	char fullPath[_MAX_PATH]{};
+	std::string path = _fullpath(fullPath, filepath, _MAX_PATH) ? fullPath : filepath;
+	for (char& c : path)
+	{
+		c = char(std::tolower(static_cast<unsigned char>(c)));
+		if (c == '/')
+			c = '\\';
+	}
+	return path;
+}
+
+uint64_t TextureCache::HashContent(const std::vector<uint8_t>& data)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (uint8_t byte : data)
+	{
+		hash ^= byte;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
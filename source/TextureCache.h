@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <future>
+#include <atomic>
+#include <mutex>
+#include "Texture.h"
+
+class ThreadPool;
+
+/* Counters of the texture cache */
+struct TextureCacheStats
+{
+	uint64_t NumHits = 0;     //Acquires that didn't decode anything, the image was already loaded (for any device)
+	uint64_t NumMisses = 0;   //Acquires that had to load an image file
+	uint64_t NumMapped = 0;   //Misses that mapped the decoded texture from the disk cache instead of decoding the image file
+	uint32_t NumTextures = 0; //Textures alive, one per image per format per device
+	uint32_t NumLoading = 0;  //Textures of which the decoding hasn't finished yet
+	size_t ResidentBytes = 0; //Texels of the software rasterizer of the loaded textures, texels shared by multiple textures count once
+};
+
+/* Process wide cache of the textures loaded from image files, so an image only gets decoded and stored once for all materials and scenes
+	Images are told apart by the content of the file, a copy of a file under another path gets shared as well
+	Textures of different devices (every scene has its own) share their texels, only the DX resource is made per device
+	Handed out textures are immutable and reference counted, every Acquire needs a matching Release
+	Decoding, format conversion and mip generation run on a pool of loader threads, so the images of a scene load in parallel
+	Decoded textures are also stored on disk, keyed by the content of the image file: later runs (and other processes) map them instead of decoding */
+class TextureCache final
+{
+public:
+	~TextureCache();
+
+	TextureCache(const TextureCache& t) = delete;
+	TextureCache(TextureCache&& t) = delete;
+	TextureCache& operator=(const TextureCache& t) = delete;
+	TextureCache& operator=(TextureCache&& t) = delete;
+
+	/* Returns the cache of the process */
+	static TextureCache& GetInstance();
+
+	/* Returns the texture of the image file for the given device, the image gets loaded the first time it's used
+		Returns nullptr if the file can't be read */
+	const Texture* Acquire(const char* filepath, ID3D11Device* pDevice, ETextureFormat format = ETextureFormat::RGBA8);
+
+	/* Same as Acquire, without waiting for the image to be decoded: the future holds the texture once it's loaded
+		Only the file gets read (to know its content) on the calling thread, and only the first time the path is seen */
+	std::shared_future<const Texture*> AcquireAsync(const char* filepath, ID3D11Device* pDevice, ETextureFormat format = ETextureFormat::RGBA8);
+
+	/* Hands back a texture returned by Acquire(Async), it gets deleted once nothing uses it anymore (nullptr is ignored) */
+	void Release(const Texture* pTexture);
+
+	/* Returns the counters since the program started, resident memory and textures at this moment */
+	TextureCacheStats GetStats() const;
+
+	/* Sets the directory decoded textures get stored in and mapped from (created if it doesn't exist), an empty path turns the disk cache off
+		Only affects textures that aren't loading yet, the default is ./Resources/TextureCache */
+	void SetDiskCacheDirectory(const std::string& directory);
+
+	/* Makes materials ask for their maps block compressed: BC1 for color maps, BC5 for normal maps and BC4 for single channel maps
+		4-8x less texel memory for some loss in quality, only affects textures set after changing it (off by default, see --compress-textures)
+		Materials don't pack compressed scalar maps (Material::PackScalarTextures), the software rasterizer samples them separately */
+	void SetBlockCompression(bool useBlockCompression) { m_UseBlockCompression = useBlockCompression; }
+	bool UsesBlockCompression() const { return m_UseBlockCompression; }
+
+private:
+	TextureCache();
+
+	struct Entry
+	{
+		uint64_t ContentHash = 0;
+		ETextureFormat Format = ETextureFormat::RGBA8;
+		ID3D11Device* pDevice = nullptr;
+		std::shared_future<const Texture*> Future = {}; //Holds nullptr once loaded if the image couldn't be decoded
+		uint32_t RefCount = 0;
+	};
+
+	ThreadPool* m_pLoaderPool;
+	mutable std::recursive_mutex m_Mutex; //Loader threads release the sources of textures for other devices, recursive as the pool can run tasks inline
+	std::vector<Entry> m_Entries; //A handful of textures per scene, a linear search is all it takes
+	std::unordered_map<std::string, uint64_t> m_ContentHashes; //Canonical path -> content hash, so known files don't get read again
+	uint64_t m_NumHits = 0;
+	uint64_t m_NumMisses = 0;
+	std::atomic<uint64_t> m_NumMapped; //Counted by the loader threads
+	std::string m_DiskCacheDirectory;
+	bool m_UseBlockCompression = false;
+
+	/* Returns the entry of the image for the device (or any device when nullptr), nullptr if there's none */
+	Entry* FindEntry(uint64_t contentHash, ETextureFormat format, const ID3D11Device* pDevice);
+
+	/* Returns true if the texture of the entry is done loading */
+	static bool IsLoaded(const Entry& entry);
+
+	/* Returns the path of the disk cache file of the image in the given format, empty if the disk cache is off */
+	std::string GetDiskCacheFilepath(uint64_t contentHash, ETextureFormat format) const;
+
+	/* Returns a future that already holds the texture */
+	static std::shared_future<const Texture*> MakeReadyFuture(const Texture* pTexture);
+
+	/* Reads the whole file, returns false if it can't be read */
+	static bool ReadFile(const std::string& filepath, std::vector<uint8_t>& data);
+
+	/* Returns the absolute path with the same separators and casing for every way of writing it */
+	static std::string GetCanonicalPath(const char* filepath);
+
+	/* FNV-1a hash of the data */
+	static uint64_t HashContent(const std::vector<uint8_t>& data);
+};
@@ -0,0 +1,159 @@
+#pragma once
+#include "pch.h"
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(uint32_t numThreads)
+	: m_Workers()
+	, m_Mutex()
+	, m_WakeCondition()
+	, m_DoneCondition()
+	, m_pJob(nullptr)
+	, m_JobCount(0)
+	, m_NextJobIndex(0)
+	, m_NumBusyWorkers(0)
+	, m_Generation(0)
+	, m_IsStopping(false)
+	, m_Tasks()
+{
+	StartWorkers(numThreads);
+}
+
+ThreadPool::~ThreadPool()
+{
+	StopWorkers();
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job)
+{
+	if (count == 0)
+		return;
+
+	//Not worth waking up the workers for a single job (or when we don't have any)
+	if (count == 1 || m_Workers.empty())
+	{
+		for (uint32_t i = 0; i < count; ++i)
+			job(i);
+		return;
+	}
+
+	//Publish the job and wake up all workers
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_pJob = &job;
+		m_JobCount = count;
+		m_NextJobIndex = 0;
+		m_NumBusyWorkers = uint32_t(m_Workers.size());
+		++m_Generation;
+	}
+	m_WakeCondition.notify_all();
+
+	//Calling thread helps out instead of idling
+	RunJobs();
+
+	//Wait until every worker checked back in, only then the job is allowed to go out of scope
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_DoneCondition.wait(lock, [this]() { return m_NumBusyWorkers == 0; });
+	m_pJob = nullptr;
+}
+
+void ThreadPool::SetThreadCount(uint32_t numThreads)
+{
+	if (numThreads == 0)
+		numThreads = GetHardwareThreadCount();
+
+	if (numThreads == GetThreadCount())
+		return;
+
+	StopWorkers();
+	StartWorkers(numThreads);
+}
+
+uint32_t ThreadPool::GetHardwareThreadCount()
+{
+	uint32_t hardwareThreads = std::thread::hardware_concurrency();
+	return (hardwareThreads == 0) ? 1 : hardwareThreads;
+}
+
+void ThreadPool::StartWorkers(uint32_t numThreads)
+{
+	if (numThreads == 0)
+		numThreads = GetHardwareThreadCount();
+
+	//The calling thread always counts as one of the threads
+	m_IsStopping = false;
+	for (uint32_t i = 1; i < numThreads; ++i)
+	{
+		m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, m_Generation);
+	}
+}
+
+void ThreadPool::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_IsStopping = true;
+	}
+	m_WakeCondition.notify_all();
+
+	for (std::thread& worker : m_Workers)
+	{
+		if (worker.joinable())
+			worker.join();
+	}
+	m_Workers.clear();
+}
+
+void ThreadPool::WorkerLoop(uint64_t lastGeneration)
+{
+	while (true)
+	{
+		//Sleep until a new job is published, a task is queued or the pool shuts down
+		std::function<void()> task{};
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WakeCondition.wait(lock, [this, lastGeneration]() { return m_IsStopping || m_Generation != lastGeneration || !m_Tasks.empty(); });
+
+			//A ParallelFor goes first, its calling thread is waiting for every worker
+			if (m_Generation != lastGeneration)
+			{
+				lastGeneration = m_Generation;
+			}
+			else if (!m_Tasks.empty())
+			{
+				task = std::move(m_Tasks.front());
+				m_Tasks.pop_front();
+			}
+			else
+			{
+				return; //Stopping, only once the queue is empty
+			}
+		}
+
+		if (task)
+		{
+			task();
+			continue;
+		}
+
+		RunJobs();
+
+		//Check back in, last one out wakes up the thread waiting in ParallelFor
+		bool isLastWorker = false;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			isLastWorker = (--m_NumBusyWorkers == 0);
+		}
+		if (isLastWorker)
+			m_DoneCondition.notify_one();
+	}
+}
+
+void ThreadPool::RunJobs()
+{
+	//Every thread grabs the next free index until all are taken
+	const std::function<void(uint32_t)>& job = *m_pJob;
+	for (uint32_t i = m_NextJobIndex++; i < m_JobCount; i = m_NextJobIndex++)
+	{
+		job(i);
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <deque>
+#include <future>
+#include <memory>
+
+class ThreadPool final
+{
+public:
+	/* Creates a pool that spreads jobs over the given amount of threads (calling thread included)
+		A thread count of 0 uses all available hardware threads */
+	ThreadPool(uint32_t numThreads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool& t) = delete;
+	ThreadPool(ThreadPool&& t) = delete;
+	ThreadPool& operator=(const ThreadPool& t) = delete;
+	ThreadPool& operator=(ThreadPool&& t) = delete;
+
+	/* Runs the job for every index in [0, count), spread over all threads of the pool
+		Blocks until every index has been processed */
+	void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job);
+
+	/* Queues the task for one of the workers and returns a future for its result, the calling thread doesn't wait
+		Runs the task right away when the pool has no workers (single thread)
+		Tasks share the workers with ParallelFor, which waits for workers that are still busy with a task */
+	template<typename Task>
+	auto Submit(Task&& task) -> std::future<decltype(task())>
+	{
+		using Result = decltype(task());
+		auto pTask = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+		std::future<Result> future = pTask->get_future();
+		if (m_Workers.empty())
+		{
+			(*pTask)();
+			return future;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Tasks.emplace_back([pTask]() { (*pTask)(); });
+		}
+		m_WakeCondition.notify_one();
+		return future;
+	}
+
+	/* Restarts the pool with the given amount of threads (0 = all available hardware threads) */
+	void SetThreadCount(uint32_t numThreads);
+
+	/* Returns amount of threads that work on a job, calling thread included */
+	uint32_t GetThreadCount() const { return uint32_t(m_Workers.size()) + 1; }
+
+	/* Returns amount of hardware threads available on this machine (at least 1) */
+	static uint32_t GetHardwareThreadCount();
+
+private:
+	std::vector<std::thread> m_Workers;
+	std::mutex m_Mutex;
+	std::condition_variable m_WakeCondition;
+	std::condition_variable m_DoneCondition;
+
+	/* Current job, only valid while a ParallelFor call is running */
+	const std::function<void(uint32_t)>* m_pJob;
+	uint32_t m_JobCount;
+	std::atomic<uint32_t> m_NextJobIndex;
+	uint32_t m_NumBusyWorkers;
+	uint64_t m_Generation;
+	bool m_IsStopping;
+
+	/* Submitted tasks, oldest first, queued tasks still run when the pool stops */
+	std::deque<std::function<void()>> m_Tasks;
+
+	/* Private functions */
+	void StartWorkers(uint32_t numThreads);
+	void StopWorkers();
+	void WorkerLoop(uint64_t lastGeneration);
+	void RunJobs();
+};
@@ -3,160 +3,240 @@
 #include "EMath.h"
 #include "Triangle.h"
 #include "Structs.h"
-#include "Camera.h"
 #include "Effect.h"
-#include <array>
+#include "FrameArena.h"
+#include <type_traits>
+
+//Clipped triangles live in a frame arena that never calls destructors
+static_assert(std::is_trivially_destructible<Triangle>::value, "Triangle has to be trivially destructible to be stored in a FrameArena");
 
 using namespace Elite;
-Triangle::Triangle(Vertex_Input v0, Vertex_Input v1, Vertex_Input v2, unsigned int materialID)
+Triangle::Triangle(const Vertex_Output& v0, const Vertex_Output& v1, const Vertex_Output& v2, unsigned int materialID)
     : m_MaterialID(materialID)
-    , m_InputVertices(3)
-    , m_TransformedVertices(3)
-    , m_ViewDirection()
+    , m_TransformedVertices()
     , m_CullMode(ECullMode::BackCulling)
     , m_IsInsideFrustum(false)
     , m_IsTriangleClipped(false)
-    , m_ClippedTriangles()
+    , m_pClippedTriangles(nullptr)
+    , m_NumClippedTriangles(0)
 {
-    m_InputVertices[0] = v0;
-    m_InputVertices[1] = v1;
-    m_InputVertices[2] = v2;
+    m_TransformedVertices[0] = v0;
+    m_TransformedVertices[1] = v1;
+    m_TransformedVertices[2] = v2;
 }
 
 void Triangle::Update(float)
 {
 }
 
-bool Triangle::Hit(const Elite::FPoint2& pixel, HitRecord& hitRecord) const
+ESetupResult Triangle::Setup(TriangleSetup& setup, float width, float height) const
 {
-    //Before anything else, if we have a NoCulling setting we get visual artifacts
-    //That's why we're going to determine what side we're looking at from the get-go, and simply cull away the opposite of that
-    ECullMode cullmode = m_CullMode;
-    if (cullmode == ECullMode::NoCulling)
+    const FPoint4& p0 = m_TransformedVertices[0].Position;
+    const FPoint4& p1 = m_TransformedVertices[1].Position;
+    const FPoint4& p2 = m_TransformedVertices[2].Position;
+
+    //Snap vertices to 24.8 fixed-point, vertices outside of that range can't be rasterized and should have been clipped
+    const auto IsInFixedPointRange = [](const FPoint4& p)
     {
-        //Calculate normal for this triangle (reference: raytracer normal pre-calculation)
-        FVector3 v0_v1 = FVector3(m_InputVertices[1].Position - m_InputVertices[0].Position);
-        FVector3 v0_v2 = FVector3(m_InputVertices[2].Position - m_InputVertices[0].Position);
-        FVector3 normal = Elite::GetNormalized(Elite::Cross(v0_v1, v0_v2));
-        float dot = Elite::Dot(normal, hitRecord.ViewDirection);
-        if (dot > 0)
-        {
-            //Means we're looking in the same direction as the normal -> backface normal -> so cull front
-            cullmode = ECullMode::FrontCulling;
-        }
-        else
-        {
-            //Means we're looking in the same direction as the normal -> frontface normal -> so cull back
-            cullmode = ECullMode::BackCulling;
-        }
-    }
+        return std::abs(p.x) < MAX_FIXED_POINT_COORDINATE && std::abs(p.y) < MAX_FIXED_POINT_COORDINATE;
+    };
+    if (!IsInFixedPointRange(p0) || !IsInFixedPointRange(p1) || !IsInFixedPointRange(p2))
+        return ESetupResult::Rejected;
+
+    const int64_t x0 = int64_t(lroundf(p0.x * SUB_PIXEL_SCALE)), y0 = int64_t(lroundf(p0.y * SUB_PIXEL_SCALE));
+    const int64_t x1 = int64_t(lroundf(p1.x * SUB_PIXEL_SCALE)), y1 = int64_t(lroundf(p1.y * SUB_PIXEL_SCALE));
+    const int64_t x2 = int64_t(lroundf(p2.x * SUB_PIXEL_SCALE)), y2 = int64_t(lroundf(p2.y * SUB_PIXEL_SCALE));
+
+    //Total area needed to decide the weight of a vertex later (exact, since it's integer math)
+    const int64_t totalArea = (x2 - x0) * (y1 - y0) - (y2 - y0) * (x1 - x0);
+    if (totalArea == 0)
+        return ESetupResult::Rejected;
+
+    //Cullmode check, once for the whole triangle instead of once per pixel, before any edge function or attribute gets computed
+    //-> The sign of the area tells us which side of the triangle we're looking at (depends on the winding order on screen)
+    //-> NoCulling keeps both sides
+    if (m_CullMode == ECullMode::BackCulling && totalArea < 0) return ESetupResult::Culled;
+    else if (m_CullMode == ECullMode::FrontCulling && totalArea > 0) return ESetupResult::Culled;
+
+    //Edge functions, flipped for negative areas so the inside test is always a positive check
+    //Top-left fill rule: pixels exactly on an edge only belong to the triangle if it's a top or left edge,
+    //so pixels on an edge shared by 2 triangles are only drawn once
+    //-> (A, B) points to the inside: left edge = inside is to the right (A > 0), top edge = horizontal with inside below it (A == 0, B > 0)
+    const int64_t sign = (totalArea > 0) ? 1 : -1;
+    const auto SetEdge = [sign](EdgeFunction& edge, int64_t fromX, int64_t fromY, int64_t toX, int64_t toY)
+    {
+        const int64_t a = (toY - fromY) * sign;
+        const int64_t b = (fromX - toX) * sign;
+        const bool isTopLeft = (a > 0) || (a == 0 && b > 0);
+
+        //Pixel (c, r) is sampled at fixed-point position (c << SUB_PIXEL_BITS, r << SUB_PIXEL_BITS)
+        edge.StepX = a * SUB_PIXEL_SCALE;
+        edge.StepY = b * SUB_PIXEL_SCALE;
+        edge.Origin = -(a * fromX + b * fromY) - (isTopLeft ? 0 : 1);
+    };
+    SetEdge(setup.Edges[0], x1, y1, x2, y2);
+    SetEdge(setup.Edges[1], x2, y2, x0, y0);
+    SetEdge(setup.Edges[2], x0, y0, x1, y1);
+    setup.InvArea = 1.f / float(totalArea * sign);
+    setup.W1StepX = float(setup.Edges[1].StepX) * setup.InvArea;
+    setup.W1StepY = float(setup.Edges[1].StepY) * setup.InvArea;
+    setup.W2StepX = float(setup.Edges[2].StepX) * setup.InvArea;
+    setup.W2StepY = float(setup.Edges[2].StepY) * setup.InvArea;
+
+    //Bounding box of pixels whose sample position can be covered, clamped to the screen
+    const int64_t minX = std::min(x0, std::min(x1, x2));
+    const int64_t minY = std::min(y0, std::min(y1, y2));
+    const int64_t maxX = std::max(x0, std::max(x1, x2));
+    const int64_t maxY = std::max(y0, std::max(y1, y2));
+    setup.MinX = int32_t(std::max<int64_t>((minX + SUB_PIXEL_SCALE - 1) >> SUB_PIXEL_BITS, 0));
+    setup.MinY = int32_t(std::max<int64_t>((minY + SUB_PIXEL_SCALE - 1) >> SUB_PIXEL_BITS, 0));
+    setup.MaxX = int32_t(std::min<int64_t>((maxX >> SUB_PIXEL_BITS) + 1, int64_t(width)));
+    setup.MaxY = int32_t(std::min<int64_t>((maxY >> SUB_PIXEL_BITS) + 1, int64_t(height)));
+    setup.MatID = m_MaterialID;
+
+    //Triangle doesn't cover any pixel on screen, no need for its attributes
+    if (setup.MinX >= setup.MaxX || setup.MinY >= setup.MaxY)
+        return ESetupResult::Rejected;
+
+    //Attribute planes, every attribute is divided by the view space depth (w) of its vertex
+    const Vertex_Output& v0 = m_TransformedVertices[0];
+    const Vertex_Output& v1 = m_TransformedVertices[1];
+    const Vertex_Output& v2 = m_TransformedVertices[2];
+    const float invW0 = 1.f / p0.w;
+    const float invW1 = 1.f / p1.w;
+    const float invW2 = 1.f / p2.w;
+
+    const auto SetPlanes = [invW0, invW1, invW2](AttributePlane* pPlanes, const FVector3& a0, const FVector3& a1, const FVector3& a2)
+    {
+        pPlanes[0].Set(a0.x * invW0, a1.x * invW1, a2.x * invW2);
+        pPlanes[1].Set(a0.y * invW0, a1.y * invW1, a2.y * invW2);
+        pPlanes[2].Set(a0.z * invW0, a1.z * invW1, a2.z * invW2);
+    };
 
-    //Total area needed to decide the weight of a vertex later
-    FVector2 a{ m_TransformedVertices[1].Position - m_TransformedVertices[0].Position };
-    FVector2 b{ m_TransformedVertices[2].Position - m_TransformedVertices[0].Position };
-    float totalArea = Cross(b, a);
-    std::array<float, 3> weights;
-
-    //Check first edge
-    FVector2 edgeA{ m_TransformedVertices[1].Position - m_TransformedVertices[0].Position };
-    FVector2 toPixel{ pixel - FPoint2(m_TransformedVertices[0].Position) };
-
-    //Inside-outside test
-    //Cullmode integration (tried doing it the same way using dot products like in raytracer -> results in artifacts)
-    //-> Figured it could have to do with the order of how vertices are defined (counterclockwise vs clockwise)
-    //-> On discord people explained how in the inside outside test:
-    //-> We can check the signs of the cross products along with the cullmode to determine if it should be visible or not
-    float signedArea = Cross(toPixel, edgeA);
-
-    //Cullmode check
-    if (cullmode == ECullMode::BackCulling && (signedArea < 0)) return false;
-    else if (cullmode == ECullMode::FrontCulling && (signedArea > 0)) return false;
-
-    //Set weight of v2
-    weights[2] = signedArea / totalArea;
-
-    //Continue with next edge
-    FVector2 edgeB{ m_TransformedVertices[2].Position - m_TransformedVertices[1].Position };
-    toPixel = pixel - FPoint2(m_TransformedVertices[1].Position);
-
-    //Cullmode check
-    signedArea = Cross(toPixel, edgeB);
-    if (cullmode == ECullMode::BackCulling && (signedArea < 0)) return false;
-    else if (cullmode == ECullMode::FrontCulling && (signedArea > 0)) return false;
-
-    //Set weight of v0
-    weights[0] = signedArea / totalArea;
-
-    //Continue with last edge
-    FVector2 edgeC{ m_TransformedVertices[0].Position - m_TransformedVertices[2].Position };
-    toPixel = pixel - FPoint2(m_TransformedVertices[2].Position);
-
-    //Cullmode check
-    signedArea = Cross(toPixel, edgeC);
-    if (cullmode == ECullMode::BackCulling && (signedArea < 0)) return false;
-    else if (cullmode == ECullMode::FrontCulling && (signedArea > 0)) return false;
-
-    //Set weight of v1
-    weights[1] = signedArea / totalArea;
-
-    //Interpolated values
-    hitRecord.InterpolatedZ = GetInterpolatedDepthInSS(weights);
-    hitRecord.InterpolatedW = GetInterpolatedDepthInVS(weights);
-    hitRecord.InterpolatedColor = GetInterpolatedColor(weights, hitRecord.InterpolatedW);
-    hitRecord.InterpolatedUV = GetInterpolatedUV(weights, hitRecord.InterpolatedW);
-    hitRecord.InterpolatedVertexNormal = GetInterpolatedVertexNormal(weights, hitRecord.InterpolatedW);
-    hitRecord.InterpolatedTangent = GetInterpolatedTangent(weights, hitRecord.InterpolatedW);
-    hitRecord.ViewDirection = GetInterpolatedViewDirection(weights, hitRecord.InterpolatedW);
-    hitRecord.MatID = m_MaterialID;
-    return true;
+    setup.InvDepthSS.Set(1.f / p0.z, 1.f / p1.z, 1.f / p2.z);
+    setup.InvDepthVS.Set(invW0, invW1, invW2);
+    setup.Color[0].Set(v0.Color.r * invW0, v1.Color.r * invW1, v2.Color.r * invW2);
+    setup.Color[1].Set(v0.Color.g * invW0, v1.Color.g * invW1, v2.Color.g * invW2);
+    setup.Color[2].Set(v0.Color.b * invW0, v1.Color.b * invW1, v2.Color.b * invW2);
+    setup.UV[0].Set(v0.UV.x * invW0, v1.UV.x * invW1, v2.UV.x * invW2);
+    setup.UV[1].Set(v0.UV.y * invW0, v1.UV.y * invW1, v2.UV.y * invW2);
+    SetPlanes(setup.VertexNormal, v0.VertexNormal, v1.VertexNormal, v2.VertexNormal);
+    SetPlanes(setup.Tangent, v0.Tangent, v1.Tangent, v2.Tangent);
+    SetPlanes(setup.ViewDirection, v0.ViewDirection, v1.ViewDirection, v2.ViewDirection);
+    return ESetupResult::Visible;
 }
 
-void Triangle::TransformVertices(float width, float height, const Elite::FMatrix4& worldMatrix, Camera* pCamera, const KeyBindInfo& keyBindInfo, bool invertToRHS)
+void Triangle::Interpolate(const TriangleSetup& setup, float w1, float w2, HitRecord& hitRecord)
 {
-    //Since the vertices are parsed for DirectX (LHS) we have to revert it to work for our SRAS in RHS
-    if (invertToRHS)
-        InvertAttributesToRHS(m_InputVertices);
+    //Interpolated w-component (= z-component in view space)
+    hitRecord.InterpolatedW = 1.f / setup.InvDepthVS.Evaluate(w1, w2);
+    const float depthVS = hitRecord.InterpolatedW;
 
-    //Gather camera variables
-    const auto& cameraToWorld = pCamera->GetLookAtMatrix();
-    const auto& projMatrix = pCamera->GetProjMatrix();
+    hitRecord.InterpolatedColor = RGBColor
+    {
+        setup.Color[0].Evaluate(w1, w2) * depthVS,
+        setup.Color[1].Evaluate(w1, w2) * depthVS,
+        setup.Color[2].Evaluate(w1, w2) * depthVS
+    };
+    hitRecord.InterpolatedUV = FVector2
+    {
+        setup.UV[0].Evaluate(w1, w2) * depthVS,
+        setup.UV[1].Evaluate(w1, w2) * depthVS
+    };
 
-    //Model to WorldSpace -> to ViewSpace -> to Projection Space
-    Elite::FMatrix4 worldViewProjMatrix = projMatrix * Elite::Inverse(cameraToWorld) * ((invertToRHS) ? Elite::Inverse(worldMatrix) : worldMatrix);
-    for (int i = 0; i < 3; ++i)
+    //UV derivatives like the differences within a 2x2 quad, straight from the planes so no helper pixels are needed
+    const auto EvaluateUV = [&setup](float neighbourW1, float neighbourW2)
     {
-        //Copy over attributes
-        m_TransformedVertices[i].Color = m_InputVertices[i].Color;
-        m_TransformedVertices[i].UV = m_InputVertices[i].UV;
+        const float neighbourDepthVS = 1.f / setup.InvDepthVS.Evaluate(neighbourW1, neighbourW2);
+        return FVector2{ setup.UV[0].Evaluate(neighbourW1, neighbourW2) * neighbourDepthVS, setup.UV[1].Evaluate(neighbourW1, neighbourW2) * neighbourDepthVS };
+    };
+    hitRecord.UVDerivativeX = EvaluateUV(w1 + setup.W1StepX, w2 + setup.W2StepX) - hitRecord.InterpolatedUV;
+    hitRecord.UVDerivativeY = EvaluateUV(w1 + setup.W1StepY, w2 + setup.W2StepY) - hitRecord.InterpolatedUV;
+
+    //Directions get normalized, so multiplying with the depth isn't needed
+    hitRecord.InterpolatedVertexNormal = GetNormalized(FVector3
+    {
+        setup.VertexNormal[0].Evaluate(w1, w2),
+        setup.VertexNormal[1].Evaluate(w1, w2),
+        setup.VertexNormal[2].Evaluate(w1, w2)
+    });
+    hitRecord.InterpolatedTangent = GetNormalized(FVector3
+    {
+        setup.Tangent[0].Evaluate(w1, w2),
+        setup.Tangent[1].Evaluate(w1, w2),
+        setup.Tangent[2].Evaluate(w1, w2)
+    });
+    hitRecord.ViewDirection = GetNormalized(FVector3
+    {
+        setup.ViewDirection[0].Evaluate(w1, w2),
+        setup.ViewDirection[1].Evaluate(w1, w2),
+        setup.ViewDirection[2].Evaluate(w1, w2)
+    });
+    hitRecord.MatID = setup.MatID;
+}
 
-        //Transform normals and tangents in ONLY WORLD SPACE
-        m_TransformedVertices[i].VertexNormal = FMatrix3(worldMatrix) * GetNormalized(m_InputVertices[i].VertexNormal);
-        m_TransformedVertices[i].Tangent = FMatrix3(worldMatrix) * GetNormalized(m_InputVertices[i].Tangent);
+void Triangle::TransformVertex(const Vertex_Input& input, Vertex_Output& output, const DrawConstants& constants)
+{
+    //Since the vertices are parsed for DirectX (LHS) we have to revert it to work for our SRAS in RHS
+    Vertex_Input vertex = input;
+    if (constants.InvertToRHS)
+    {
+        vertex.Position.z = -vertex.Position.z;
+        vertex.VertexNormal.z = -vertex.VertexNormal.z;
+        vertex.Tangent.z = -vertex.Tangent.z;
+    }
 
-        //Make world position and store view directions
-        m_TransformedVertices[i].WorldPosition = worldMatrix * FPoint4(m_InputVertices[i].Position, 1.f);
-        m_ViewDirection[i] = GetNormalized(m_TransformedVertices[i].WorldPosition - FPoint4(pCamera->GetPosition(), 1.f));
+    //Copy over attributes
+    output.Color = vertex.Color;
+    output.UV = vertex.UV;
 
-        //Model in homogeneous Space -> Clipping Space
-        m_TransformedVertices[i].Position = worldViewProjMatrix * FPoint4(m_InputVertices[i].Position, 1.f);
-    }
+    //Transform normals and tangents in ONLY WORLD SPACE
+    output.VertexNormal = constants.Normal * GetNormalized(vertex.VertexNormal);
+    output.Tangent = constants.Normal * GetNormalized(vertex.Tangent);
+
+    //Make world position and store view directions
+    output.WorldPosition = constants.World * FPoint4(vertex.Position, 1.f);
+    output.ViewDirection = FVector3(GetNormalized(output.WorldPosition - FPoint4(constants.CameraPosition, 1.f)));
+
+    //Model in homogeneous Space -> Clipping Space
+    output.Position = constants.WorldViewProjection * FPoint4(vertex.Position, 1.f);
+}
 
+Elite::FVector2 Triangle::GetGuardBand(float width, float height, const KeyBindInfo& keyBindInfo)
+{
+    //Guard band in NDC, the bounding box clamp in Setup already keeps the raster work on screen
+    if (keyBindInfo.UseGuardBand && !keyBindInfo.UseSimpleFrustumCulling)
+        return FVector2{ 2.f * GUARD_BAND_SIZE / width - 1.f, 2.f * GUARD_BAND_SIZE / height - 1.f };
+
+    return FVector2{ 1.f, 1.f };
+}
+
+void Triangle::ProjectToScreen(float width, float height, const KeyBindInfo& keyBindInfo, FrameArena& clipArena, bool needsClipping)
+{
+    //Mesh lies inside of the frustum, so this triangle does too
+    if (!needsClipping)
+    {
+        m_pClippedTriangles = nullptr;
+        m_NumClippedTriangles = 0;
+        m_IsTriangleClipped = false;
+        m_IsInsideFrustum = true;
+    }
     //Simple frustum culling that culls away the triangle as soon as 1 vertex is out of the view plane
-    if (keyBindInfo.UseSimpleFrustumCulling)
+    else if (keyBindInfo.UseSimpleFrustumCulling)
     {
         DoSimpleFrustumCulling();
         if (!m_IsInsideFrustum)
             return;
     }
-    //3D Clipping applied on the triangle (only culls when all vertices are out of view plane)
+    //3D Clipping applied on the triangle against all 6 planes (only culls when all vertices are outside of the same plane)
     else
     {
         //Clear clipped triangles
-        m_ClippedTriangles.clear();
+        m_pClippedTriangles = nullptr;
+        m_NumClippedTriangles = 0;
         m_IsTriangleClipped = false;
 
-        //For now I'm only testing clipping to the left side of the screen
-        DoClippingX();
+        ClipToFrustum(clipArena, GetGuardBand(width, height, keyBindInfo));
         if (!m_IsInsideFrustum)
             return;
     }
@@ -164,8 +244,9 @@ void Triangle::TransformVertices(float width, float height, const Elite::FMatrix
     //Only applies in case 3D clipping is applied -> will further transform all the newly made triangles
     if (m_IsTriangleClipped)
     {
-        for (Triangle& t : m_ClippedTriangles)
+        for (uint32_t clippedIdx = 0; clippedIdx < m_NumClippedTriangles; ++clippedIdx)
         {
+            Triangle& t = m_pClippedTriangles[clippedIdx];
             //Further transformation of spaces
             for (int i = 0; i < 3; ++i)
             {
@@ -201,115 +282,6 @@ void Triangle::TransformVertices(float width, float height, const Elite::FMatrix
     }
 }
 
-void Triangle::AdjustBoundingBox(BoundingBox& boundingBox, float width, float height) const
-{
-    //Determining topLeft and bottomRight point for our bounding box depending on where the triangle is
-    for (size_t i = 0; i < 3; ++i)
-    {
-        boundingBox.TopLeft.x = std::min(boundingBox.TopLeft.x, m_TransformedVertices[i].Position.x);
-        boundingBox.TopLeft.y = std::min(boundingBox.TopLeft.y, m_TransformedVertices[i].Position.y);
-
-        boundingBox.BottomRight.x = std::max(boundingBox.BottomRight.x, m_TransformedVertices[i].Position.x);
-        boundingBox.BottomRight.y = std::max(boundingBox.BottomRight.y, m_TransformedVertices[i].Position.y);
-    }
-
-    //In case of bounding box going out of screen dimensions, we have to clamp it
-    if (boundingBox.TopLeft.x < 0)
-        boundingBox.TopLeft.x = 0;
-
-    if (boundingBox.TopLeft.y < 0)
-        boundingBox.TopLeft.y = 0;
-
-    if (boundingBox.BottomRight.x > width)
-        boundingBox.BottomRight.x = width;
-
-    if (boundingBox.BottomRight.y > height)
-        boundingBox.BottomRight.y = height;
-
-    //Flooring/ceiling since we'll be comparing to integer values that represent the pixel later
-    boundingBox.TopLeft.x = std::floorf(boundingBox.TopLeft.x);
-    boundingBox.TopLeft.y = std::floorf(boundingBox.TopLeft.y);
-    boundingBox.BottomRight.x = std::ceilf(boundingBox.BottomRight.x);
-    boundingBox.BottomRight.y = std::ceilf(boundingBox.BottomRight.y);
-}
-
-Elite::FVector3 Triangle::GetInterpolatedTangent(const std::array<float, 3>& weights, float interpolatedDepthVS) const
-{
-    Elite::FVector3 interpolatedTangent
-    {
-        ((m_TransformedVertices[0].Tangent / m_TransformedVertices[0].Position.w) * weights[0] +
-         (m_TransformedVertices[1].Tangent / m_TransformedVertices[1].Position.w) * weights[1] +
-         (m_TransformedVertices[2].Tangent / m_TransformedVertices[2].Position.w) * weights[2]) * interpolatedDepthVS
-    };
-    return Elite::GetNormalized(interpolatedTangent);
-}
-
-Elite::FVector3 Triangle::GetInterpolatedVertexNormal(const std::array<float, 3>& weights, float interpolatedDepthVS) const
-{
-    Elite::FVector3 interpolatedVertexNormal
-    {
-        ((m_TransformedVertices[0].VertexNormal / m_TransformedVertices[0].Position.w) * weights[0] +
-         (m_TransformedVertices[1].VertexNormal / m_TransformedVertices[1].Position.w) * weights[1] +
-         (m_TransformedVertices[2].VertexNormal / m_TransformedVertices[2].Position.w) * weights[2]) * interpolatedDepthVS
-    };
-    return Elite::GetNormalized(interpolatedVertexNormal);
-}
-
-Elite::FVector3 Triangle::GetInterpolatedViewDirection(const std::array<float, 3>& weights, float interpolatedDepthVS) const
-{
-
-    Elite::FVector3 interpolatedCameraToWorldPos
-    {
-        ((m_ViewDirection[0] / m_TransformedVertices[0].Position.w) * weights[0] +
-         (m_ViewDirection[1] / m_TransformedVertices[1].Position.w) * weights[1] +
-         (m_ViewDirection[2] / m_TransformedVertices[2].Position.w) * weights[2]) * interpolatedDepthVS
-    };
-
-    return GetNormalized(interpolatedCameraToWorldPos);
-}
- 
-Elite::RGBColor Triangle::GetInterpolatedColor(const std::array<float, 3>& weights, float interpolatedDepthVS) const
-{
-    return RGBColor
-    {
-        ((m_TransformedVertices[0].Color / m_TransformedVertices[0].Position.w) * weights[0] +
-         (m_TransformedVertices[1].Color / m_TransformedVertices[1].Position.w) * weights[1] +
-         (m_TransformedVertices[2].Color / m_TransformedVertices[2].Position.w) * weights[2]) * interpolatedDepthVS
-    };
-}
-
-Elite::FVector2 Triangle::GetInterpolatedUV(const std::array<float, 3>& weights, float interpolatedDepthVS) const
-{
-    return Elite::FVector2
-    {
-        ((m_TransformedVertices[0].UV / m_TransformedVertices[0].Position.w) * weights[0] +
-         (m_TransformedVertices[1].UV / m_TransformedVertices[1].Position.w) * weights[1] +
-         (m_TransformedVertices[2].UV / m_TransformedVertices[2].Position.w) * weights[2]) * interpolatedDepthVS
-    };
-}
-float Triangle::GetInterpolatedDepthInSS(const std::array<float, 3>& weights) const
-{
-    return float
-    {
-                                        1.f
-                                         /
-        ((1.f / m_TransformedVertices[0].Position.z) * weights[0] +
-          (1.f / m_TransformedVertices[1].Position.z) * weights[1] +
-          (1.f / m_TransformedVertices[2].Position.z) * weights[2])
-    };
-}
-float Triangle::GetInterpolatedDepthInVS(const std::array<float, 3>& weights) const
-{
-    return float
-    {
-                                        1.f
-                                         /
-        ((1.f / m_TransformedVertices[0].Position.w) * weights[0] +
-          (1.f / m_TransformedVertices[1].Position.w) * weights[1] +
-          (1.f / m_TransformedVertices[2].Position.w) * weights[2])
-    };
-}
-
 void Triangle::DoSimpleFrustumCulling()
 {
     //Vertices here are defined in clipping space (1 space before perspective divide to NDC)
@@ -327,271 +299,136 @@ void Triangle::DoSimpleFrustumCulling()
     m_IsInsideFrustum = true;
 }
 
-void Triangle::InvertAttributesToRHS(std::vector<Vertex_Input>& vertices)
-{
-    for (int i = 0; i < vertices.size(); ++i)
-    {
-        vertices[i].Position.z = -vertices[i].Position.z;
-        vertices[i].VertexNormal.z = -vertices[i].VertexNormal.z;
-        vertices[i].Tangent.z = -vertices[i].Tangent.z;
-    }
-}
-
 
 
 //==============================================================================================
 //============================= CLIPPING FUNCTIONALITY STARTS HERE =============================
 //==============================================================================================
 
-bool Triangle::IsFullyOutsideFrustum() const
+float Triangle::GetClipDistance(const FPoint4& position, uint32_t plane, const FVector2& guardBand)
 {
-    //As of right now, the coordinates are in clipping space [-w, w]
-    //Check if all vertices are outsome frustum to conclude we need to fully cull away this triangle
-
-    //X values are over the right of our viewplane check:
-    if (m_TransformedVertices[0].Position.x > m_TransformedVertices[0].Position.w &&
-        m_TransformedVertices[1].Position.x > m_TransformedVertices[1].Position.w &&
-        m_TransformedVertices[2].Position.x > m_TransformedVertices[2].Position.w)
-    {
-        return true;
-    }
-
-    //X values are over the left of our viewplane check:
-    if (m_TransformedVertices[0].Position.x < -m_TransformedVertices[0].Position.w &&
-        m_TransformedVertices[1].Position.x < -m_TransformedVertices[1].Position.w &&
-        m_TransformedVertices[2].Position.x < -m_TransformedVertices[2].Position.w)
-    {
-        return true;
-    }
-
-    //Y values are over the top of our viewplane check:
-    if (m_TransformedVertices[0].Position.y > m_TransformedVertices[0].Position.w &&
-        m_TransformedVertices[1].Position.y > m_TransformedVertices[1].Position.w &&
-        m_TransformedVertices[2].Position.y > m_TransformedVertices[2].Position.w)
-    {
-        return true;
-    }
-
-    //Y values are over the bottom of our viewplane check:
-    if (m_TransformedVertices[0].Position.y < -m_TransformedVertices[0].Position.w &&
-        m_TransformedVertices[1].Position.y < -m_TransformedVertices[1].Position.w &&
-        m_TransformedVertices[2].Position.y < -m_TransformedVertices[2].Position.w)
-    {
-        return true;
-    }
-
-    //Z values are over the top of our viewplane check:
-    if (m_TransformedVertices[0].Position.z > m_TransformedVertices[0].Position.w &&
-        m_TransformedVertices[1].Position.z > m_TransformedVertices[1].Position.w &&
-        m_TransformedVertices[2].Position.z > m_TransformedVertices[2].Position.w)
-    {
-        return true;
+    //As of right now, the coordinates are in clipping space: x and y in [-w, w], z in [0, w]
+    switch (plane)
+    {
+    case LEFT_PLANE: return guardBand.x * position.w + position.x;
+    case RIGHT_PLANE: return guardBand.x * position.w - position.x;
+    case BOTTOM_PLANE: return guardBand.y * position.w + position.y;
+    case TOP_PLANE: return guardBand.y * position.w - position.y;
+    case NEAR_PLANE: return position.z;
+    case FAR_PLANE:
+    default: return position.w - position.z;
     }
+}
 
-    //Z values are over the bottom of our viewplane check:
-    if (m_TransformedVertices[0].Position.z < 0.f &&
-        m_TransformedVertices[1].Position.z < 0.f &&
-        m_TransformedVertices[2].Position.z < 0.f)
+uint32_t Triangle::GetOutCode(const FPoint4& position, const FVector2& guardBand)
+{
+    uint32_t outCode = 0;
+    for (uint32_t plane = 0; plane < NUM_CLIP_PLANES; ++plane)
     {
-        return true;
+        if (GetClipDistance(position, plane, guardBand) < 0.f)
+            outCode |= (1u << plane);
     }
-
-    //If all tests passed, our triangle is fully inside frustum 
-    return false;
+    return outCode;
 }
 
-void Triangle::DoClippingX()
+void Triangle::ClipToFrustum(FrameArena& clipArena, const FVector2& guardBand)
 {
-    //Do full culling check
-    m_IsInsideFrustum = !IsFullyOutsideFrustum();
-    if (!m_IsInsideFrustum) return;
-
-    //If only 1 vertex is on the wrong side (assuming v0 is on the wrong side)
-    const auto Clip1_X_Left = [this](Vertex_Output& v0, Vertex_Output& v1, Vertex_Output& v2, VertexOrder order)
-    {
-        //calculate alphas to get intersection point
-       // const float alphaA = ( abs(-v0.Position.w - v0.Position.x) ) / (v1.Position.x - v0.Position.x);
-       // const float alphaB = ( abs(-v0.Position.w - v0.Position.x) ) / (v2.Position.x - v0.Position.x);
-
-        const float alphaA = (-v0.Position.w - v0.Position.x) / (v1.Position.x - v0.Position.x);
-        const float alphaB = (-v0.Position.w - v0.Position.x) / (v2.Position.x - v0.Position.x);
-
-        //interpolate to get interpolated intersection point
-        auto v0a = InterpolatedVertex_Output(v0, v1, alphaA);
-        auto v0b = InterpolatedVertex_Output(v0, v2, alphaB);
-
-        //Create 2 new triangle and push to the vector
-        Triangle t1{ {}, {}, {} };
-
-        //determine original order
-        SetVerticesOnOrder(t1, v0a, v1, v2, order);
-
-        //Now we need to see if that triangle needed clipping
-        t1.DoClippingX();
-        if (t1.IsTriangleClipped())
+    //Every bit of an outcode is a plane the vertex lies outside of
+    const FVector2 screenBand{ 1.f, 1.f };
+    const FPoint4& p0 = m_TransformedVertices[0].Position;
+    const FPoint4& p1 = m_TransformedVertices[1].Position;
+    const FPoint4& p2 = m_TransformedVertices[2].Position;
+
+    //All vertices outside of the same plane of the actual frustum -> fully cull
+    m_IsInsideFrustum = (GetOutCode(p0, screenBand) & GetOutCode(p1, screenBand) & GetOutCode(p2, screenBand)) == 0;
+    if (!m_IsInsideFrustum)
+        return;
+
+    //Only the planes of the guard band need clipping, fragments behind the far plane already fail the depth test
+    uint32_t crossedPlanes = GetOutCode(p0, guardBand) | GetOutCode(p1, guardBand) | GetOutCode(p2, guardBand);
+    if (guardBand.x > 1.f || guardBand.y > 1.f)
+        crossedPlanes &= ~(1u << FAR_PLANE);
+
+    //All vertices inside of every plane -> nothing to clip
+    if (crossedPlanes == 0)
+        return;
+
+    //Sutherland-Hodgman: clip the polygon against one plane at a time, only against the planes it crosses
+    //Every plane adds at most 1 vertex, so the polygon ping-pongs between 2 fixed-size buffers
+    Vertex_Output polygons[2][MAX_CLIP_VERTICES];
+    polygons[0][0] = m_TransformedVertices[0];
+    polygons[0][1] = m_TransformedVertices[1];
+    polygons[0][2] = m_TransformedVertices[2];
+    uint32_t numVertices = 3;
+    uint32_t current = 0;
+
+    for (uint32_t plane = 0; plane < NUM_CLIP_PLANES; ++plane)
+    {
+        if ((crossedPlanes & (1u << plane)) == 0)
+            continue;
+
+        const Vertex_Output* pInput = polygons[current];
+        Vertex_Output* pOutput = polygons[1 - current];
+        uint32_t numOutput = 0;
+
+        float distance = GetClipDistance(pInput[0].Position, plane, guardBand);
+        for (uint32_t i = 0; i < numVertices; ++i)
         {
-            for (const Triangle& clippedTriangle : t1.GetClippedTriangles())
-            {
-                m_ClippedTriangles.push_back(clippedTriangle);
-            }
-        }
-        else
-        {
-            m_ClippedTriangles.push_back(t1);
-        }
-
-        //Create triangle
-        Triangle t2{ {}, {}, {} };
+            const Vertex_Output& next = pInput[(i + 1) % numVertices];
+            const float nextDistance = GetClipDistance(next.Position, plane, guardBand);
 
-        //determine original order
-        SetVerticesOnOrder(t2, v0b, v0a, v2, order);
+            //Keep the vertices on the inside, add a new vertex wherever an edge crosses the plane
+            if (distance >= 0.f)
+                pOutput[numOutput++] = pInput[i];
+            if ((distance >= 0.f) != (nextDistance >= 0.f))
+                pOutput[numOutput++] = InterpolatedVertex_Output(pInput[i], next, distance / (distance - nextDistance));
 
-        //Now we need to see if that triangle needed clipping
-        t2.DoClippingX();
-        if (t2.IsTriangleClipped())
-        {
-            for (const Triangle& clippedTriangle : t2.GetClippedTriangles())
-            {
-                m_ClippedTriangles.push_back(clippedTriangle);
-            }
+            distance = nextDistance;
         }
-        else
-        {
-            m_ClippedTriangles.push_back(t2);
-        }
-    };
 
-    //If two vertices are on the left side (assuming v0 and v1)
-    const auto Clip2_X_Left = [this](Vertex_Output& v0, Vertex_Output& v1, Vertex_Output& v2, VertexOrder order)
-    {
-        //calculate alphas to get intersection point
-        const float alphaA = (abs(-v0.Position.w - v0.Position.x)) / (v2.Position.x - v0.Position.x);
-        const float alphaB = (abs(-v1.Position.w - v1.Position.x)) / (v2.Position.x - v1.Position.x);
-
-        //interpolate to get interpolated intersection point
-        v0 = InterpolatedVertex_Output(v0, v2, alphaA);
-        v1 = InterpolatedVertex_Output(v1, v2, alphaB);
-
-        //Create new triangle
-        Triangle t{ {}, {}, {} };
+        numVertices = numOutput;
+        current = 1 - current;
 
-        //determine original order
-        SetVerticesOnOrder(t, v0, v1, v2, order);
-
-        //Now we need to see if that triangle needed clipping
-        t.DoClippingX();
-        if (t.IsTriangleClipped())
+        //Nothing (with an area) left of the polygon
+        if (numVertices < 3)
         {
-            //If so return its clipped triangles to add to this main clipped triangle vector
-            for (const Triangle& clippedTriangle : t.GetClippedTriangles())
-            {
-                m_ClippedTriangles.push_back(clippedTriangle);
-            }
-        }
-        else
-        {
-            m_ClippedTriangles.push_back(t);
-        }
-
-    };
-
-    //Clip for X out of bounds to the left
-    m_IsTriangleClipped = ClippingForComponent_NegativeRange(m_TransformedVertices[0].Position.x, m_TransformedVertices[1].Position.x, m_TransformedVertices[2].Position.x, Clip1_X_Left, Clip2_X_Left);
-
-}
-
-bool Triangle::ClippingForComponent_NegativeRange(float c0, float c1, float c2, std::function<void(Vertex_Output&, Vertex_Output&, Vertex_Output&, VertexOrder)> clip1, std::function<void(Vertex_Output&, Vertex_Output&, Vertex_Output&, VertexOrder)> clip2)
-{
-    m_IsInsideFrustum = !IsFullyOutsideFrustum();
-    if (!m_IsInsideFrustum) return false;
-
-    //Set to true on start
-    bool isClipped = true;
-
-    //plane clipping tests in clipping space (range will always be [-pos.w, pos.w] 
-    if (c0 < -m_TransformedVertices[0].Position.w)
-    {
-        if (c1 < -m_TransformedVertices[1].Position.w)
-        {
-            clip2(m_TransformedVertices[0], m_TransformedVertices[1], m_TransformedVertices[2], VertexOrder::_012);
-        }
-        else if (c2 < -m_TransformedVertices[2].Position.w)
-        {
-            clip2(m_TransformedVertices[0], m_TransformedVertices[2], m_TransformedVertices[1], VertexOrder::_021);
-        }
-        else
-        {
-            clip1(m_TransformedVertices[0], m_TransformedVertices[1], m_TransformedVertices[2], VertexOrder::_012);
-        }
-    }
-    else if (c1 < -m_TransformedVertices[1].Position.w)
-    {
-        if (c2 < -m_TransformedVertices[2].Position.w)
-        {
-            clip2(m_TransformedVertices[1], m_TransformedVertices[2], m_TransformedVertices[0], VertexOrder::_120);
-        }
-        else
-        {
-            clip1(m_TransformedVertices[1], m_TransformedVertices[0], m_TransformedVertices[2], VertexOrder::_102);
+            m_IsInsideFrustum = false;
+            return;
         }
     }
-    else if (c2 < -m_TransformedVertices[2].Position.w)
-    {
-        clip1(m_TransformedVertices[2], m_TransformedVertices[0], m_TransformedVertices[1], VertexOrder::_201);
-    }
-    else
-    {
-        //No clipping needed
-        isClipped = false;
-    }
-
-    return isClipped;
-}
 
-void Triangle::SetVerticesOnOrder(Triangle& triangle, const Vertex_Output& v0, const Vertex_Output& v1, const Vertex_Output& v2, VertexOrder order)
-{
-    if (order == VertexOrder::_012)
-    {
-        triangle.SetTransformedVertices(v0, v1, v2);
-    }
-    else if (order == VertexOrder::_021)
-    {
-        triangle.SetTransformedVertices(v0, v2, v1);
-    }
-    else if (order == VertexOrder::_102)
+    //Fan-triangulate the convex polygon, keeps the winding order of the original triangle
+    const uint32_t numTriangles = numVertices - 2;
+    Triangle* pTriangles = clipArena.Allocate<Triangle>(numTriangles);
+    if (!pTriangles)
     {
-        triangle.SetTransformedVertices(v1, v0, v2);
+        //Dropped when the arena is full, it grows before the next frame
+        m_IsInsideFrustum = false;
+        return;
     }
-    else if (order == VertexOrder::_120)
-    {
-        triangle.SetTransformedVertices(v2, v0, v1);
-    }
-    else if (order == VertexOrder::_201)
-    {
-        triangle.SetTransformedVertices(v1, v2, v0);
-    }
-    else if (order == VertexOrder::_210)
+
+    const Vertex_Output* pPolygon = polygons[current];
+    for (uint32_t i = 0; i < numTriangles; ++i)
     {
-        triangle.SetTransformedVertices(v2, v1, v0);
+        Triangle* pTriangle = new (&pTriangles[i]) Triangle(pPolygon[0], pPolygon[i + 1], pPolygon[i + 2], m_MaterialID);
+        pTriangle->SetCullMode(m_CullMode);
+        pTriangle->m_IsInsideFrustum = true;
     }
-}
-
-void Triangle::SetTransformedVertices(const Vertex_Output& v0, const Vertex_Output& v1, const Vertex_Output& v2)
-{
-    m_TransformedVertices[0] = v0;
-    m_TransformedVertices[1] = v1;
-    m_TransformedVertices[2] = v2;
+    m_pClippedTriangles = pTriangles;
+    m_NumClippedTriangles = numTriangles;
+    m_IsTriangleClipped = true;
 }
 
 Vertex_Output Triangle::InterpolatedVertex_Output(const Vertex_Output& v0, const Vertex_Output& v2, float alpha)
 {
     Vertex_Output interpolated{};
     interpolated.Position = LerpFPoint4(v0.Position, v2.Position, alpha);
-    //interpolated.Color = LerpRGBColor(v0.Color, v2.Color, alpha);
+    interpolated.Color = v0.Color + (v2.Color - v0.Color) * alpha;
     interpolated.UV = Lerp(v0.UV, v2.UV, alpha);
     interpolated.WorldPosition = LerpFPoint4(v0.WorldPosition, v2.WorldPosition, alpha);
     interpolated.VertexNormal = Lerp(v0.VertexNormal, v2.VertexNormal, alpha);
     interpolated.Tangent = Lerp(v0.Tangent, v2.Tangent, alpha);
+    interpolated.ViewDirection = Lerp(v0.ViewDirection, v2.ViewDirection, alpha);
 
     return interpolated;
 }
@@ -1,20 +1,16 @@
 #pragma once
 #include "ERGBColor.h"
-#include <vector>
-#include <functional>
+#include "Structs.h"
 
 enum class ECullMode : int;
 struct KeyBindInfo;
-struct HitRecord;
-struct BoundingBox;
-struct Vertex_Input;
-struct Vertex_Output;
-class Camera;
+class FrameArena;
 
 class Triangle final
 {
 public:
-	Triangle(Vertex_Input v0, Vertex_Input v1, Vertex_Input v2, unsigned int materialID = 0);
+	/* Assembles a triangle from 3 vertices that were already transformed by TransformVertex */
+	Triangle(const Vertex_Output& v0, const Vertex_Output& v1, const Vertex_Output& v2, unsigned int materialID = 0);
 	Triangle(const Triangle& t) = default;
 	Triangle(Triangle&& t) = default;
 	Triangle& operator=(Triangle&& t) = default;
@@ -24,83 +20,81 @@ public:
 	/* Updates the triangle */
 	void Update(float deltaT);
 
-	/* Determines if a pixel overlaps with the current triangle, stores hit information in the passed hit record */
-	bool Hit(const Elite::FPoint2& pixel, HitRecord& hitRecord) const;
+	/* Computes the edge functions, bounding box and attribute planes of this (screen space) triangle, so the pixel loop only has to evaluate them
+		The cullmode is decided here once for the whole triangle, from the sign of its screen space area
+		Returns why the triangle isn't visible (culled/rejected), the setup is only filled in for visible triangles */
+	ESetupResult Setup(TriangleSetup& setup, float width, float height) const;
 
-	/* Transforms the input vertices accordingly and stores them into the transformed vertices to be used in further calculations */
-	void TransformVertices(float width, float height, const Elite::FMatrix4& worldMatrix, Camera* pCamera, const KeyBindInfo& keyBindInfo, bool invertToRHS);
+	/* Stores the perspective correct attributes at the given barycentric weights of vertex 1 and 2 in the passed hit record */
+	static void Interpolate(const TriangleSetup& setup, float w1, float w2, HitRecord& hitRecord);
 
-	/* Adjusts the passed bounding box to fit neatly around this triangle */
-	void AdjustBoundingBox(BoundingBox& boundingBox, float width, float height) const;
+	/* Transforms a single vertex of a mesh to clipping space, its normal, tangent and view direction to world space
+		Done once per vertex per frame, the triangles sharing the vertex only reference the result */
+	static void TransformVertex(const Vertex_Input& input, Vertex_Output& output, const DrawConstants& constants);
+
+	/* Culls or clips the triangle against the frustum and transforms the remaining vertices from clipping space to screen space
+		Triangles made by clipping are stored in the given arena, they stay valid until it gets reset
+		Triangles of a mesh that lies inside of the frustum can skip culling and clipping (needsClipping = false) */
+	void ProjectToScreen(float width, float height, const KeyBindInfo& keyBindInfo, FrameArena& clipArena, bool needsClipping = true);
+
+	/* Returns how far (in NDC) triangles can reach outside of the screen before they need clipping, (1, 1) when there's no guard band */
+	static Elite::FVector2 GetGuardBand(float width, float height, const KeyBindInfo& keyBindInfo);
 
 	/* Returns true if the triangle falls inside our view plane, useful test to know whether clipping should be applied or not */
 	bool IsInsideFrustum() const { return m_IsInsideFrustum; }
 
-	/* Returns const reference to the vector holding all input vertices */
-	const std::vector<Vertex_Input>& GetInputVertices() const { return m_InputVertices; }
-
-	/* Returns const reference to the vector holding all input vertices */
-	const std::vector<Vertex_Output>& GetOutputVertices() const { return m_TransformedVertices; }
+	/* Returns pointer to the 3 transformed vertices */
+	const Vertex_Output* GetOutputVertices() const { return m_TransformedVertices; }
 
 	/* Sets cullmode of triangle */
 	void SetCullMode(ECullMode cullmode) { m_CullMode = cullmode; }
 
 	//========PUBLIC CLIPPING FUNCTIONALITY========
-	enum class VertexOrder
-	{
-		_012,
-		_021,
-		_102,
-		_120,
-		_201,
-		_210
-	};
-
-	void SetTransformedVertices(const Vertex_Output& v0, const Vertex_Output& v1, const Vertex_Output& v2);
-
 	bool IsTriangleClipped() const { return m_IsTriangleClipped; }
-	const std::vector<Triangle>& GetClippedTriangles() const { return m_ClippedTriangles; }
+	const Triangle* GetClippedTriangles() const { return m_pClippedTriangles; }
+	uint32_t GetNumClippedTriangles() const { return m_NumClippedTriangles; }
 	//=============================================
 
 private:
 	const unsigned int m_MaterialID;
-	std::vector<Vertex_Input> m_InputVertices;
-	std::vector<Vertex_Output> m_TransformedVertices;
-	Elite::FVector4 m_ViewDirection[3];
+	Vertex_Output m_TransformedVertices[3];
 	ECullMode m_CullMode;
 	bool m_IsInsideFrustum;
 
 	/* Private Functions */
-	Elite::FVector3 GetInterpolatedTangent(const std::array<float, 3>& weights, float interpolatedDepthVS) const;
-	Elite::FVector3 GetInterpolatedVertexNormal(const std::array<float, 3>& weights, float interpolatedDepthVS) const;
-	Elite::FVector3 GetInterpolatedViewDirection(const std::array<float, 3>& weights, float interpolatedDepthVS) const;
-	Elite::RGBColor GetInterpolatedColor(const std::array<float, 3>& weights, float interpolatedDepthVS) const;
-	Elite::FVector2 GetInterpolatedUV(const std::array<float, 3>& weights, float interpolatedDepthVS) const;
-
-	/* Interpolated z-component (= z-component in screen space) */
-	float GetInterpolatedDepthInSS(const std::array<float, 3>& weights) const;
-
-	/* Interpolated w-component (= z-component in view space) */
-	float GetInterpolatedDepthInVS(const std::array<float, 3>& weights) const;
-
 	/* If 1 vertex is out of bounds -> apply frustum culling for this triangle */
 	void DoSimpleFrustumCulling();
 
-	/* If vertices and attributes are defined in a lhs (for DirectX) -> invert Z-components to work for a rhs */
-	void InvertAttributesToRHS(std::vector<Vertex_Input>& vertices);
-
 	//========PRIVATE CLIPPING FUNCTIONALITY========
 	bool m_IsTriangleClipped = false;
-	std::vector<Triangle> m_ClippedTriangles;
-
-	void DoClippingX();
-	bool IsFullyOutsideFrustum() const;
-	bool ClippingForComponent_NegativeRange(float c0, float c1, float c2,
-		std::function<void(Vertex_Output&, Vertex_Output&, Vertex_Output&, VertexOrder)> clip1,
-		std::function<void(Vertex_Output&, Vertex_Output&, Vertex_Output&, VertexOrder)> clip2);
-
-	void SetVerticesOnOrder(Triangle& triangle, const Vertex_Output& v0, const Vertex_Output& v1, const Vertex_Output& v2, VertexOrder order);
-	Vertex_Output InterpolatedVertex_Output(const Vertex_Output& v0, const Vertex_Output& v2, float alpha);
-	Elite::FPoint4 LerpFPoint4(const Elite::FPoint4& v0, const Elite::FPoint4& v1, float alpha);
+	Triangle* m_pClippedTriangles = nullptr; //Lie next to each other in the clip arena
+	uint32_t m_NumClippedTriangles = 0;
+
+	//Clipping space planes, a bit per plane in the outcodes
+	static const uint32_t LEFT_PLANE = 0;
+	static const uint32_t RIGHT_PLANE = 1;
+	static const uint32_t BOTTOM_PLANE = 2;
+	static const uint32_t TOP_PLANE = 3;
+	static const uint32_t NEAR_PLANE = 4;
+	static const uint32_t FAR_PLANE = 5;
+	static const uint32_t NUM_CLIP_PLANES = 6;
+
+	//Every plane can add 1 vertex to the triangle
+	static const uint32_t MAX_CLIP_VERTICES = 3 + NUM_CLIP_PLANES;
+
+	/* Clips the triangle against the frustum (Sutherland-Hodgman), the resulting polygon gets fan-triangulated into the clip arena
+		With a guard band (> 1), the side planes are pushed out to it and the far plane is left to the depth test,
+		so only triangles crossing the near plane or leaving the guard band get clipped */
+	void ClipToFrustum(FrameArena& clipArena, const Elite::FVector2& guardBand);
+
+	/* Returns signed distance of the clipping space position to the plane, positive on the inside
+		The side planes lie at x = +-guardBand.x * w and y = +-guardBand.y * w */
+	static float GetClipDistance(const Elite::FPoint4& position, uint32_t plane, const Elite::FVector2& guardBand);
+
+	/* Returns bit mask of the planes the clipping space position lies outside of */
+	static uint32_t GetOutCode(const Elite::FPoint4& position, const Elite::FVector2& guardBand);
+
+	static Vertex_Output InterpolatedVertex_Output(const Vertex_Output& v0, const Vertex_Output& v2, float alpha);
+	static Elite::FPoint4 LerpFPoint4(const Elite::FPoint4& v0, const Elite::FPoint4& v1, float alpha);
 	//==============================================
 };
\ No newline at end of file
@@ -25,11 +25,32 @@ TriangleMesh::TriangleMesh(unsigned int id, const std::vector<Vertex_Input>& ver
 	)
 	, m_VertexBuffer(vertices)
 	, m_Indices(indices)
+	, m_BoundingVolume()
 	, m_pVertexBuffer(nullptr)
 	, m_pIndexBuffer(nullptr)
 	, m_AmountIndices((uint32_t)indices.size())
 	, m_pVertexLayout(nullptr)
 {
+	//Bounding volumes only change when the vertices do, so they're computed once
+	if (m_VertexBuffer.empty())
+		return;
+
+	m_BoundingVolume.Min = m_VertexBuffer[0].Position;
+	m_BoundingVolume.Max = m_VertexBuffer[0].Position;
+	for (const Vertex_Input& vertex : m_VertexBuffer)
+	{
+		m_BoundingVolume.Min = FPoint3{ std::min(m_BoundingVolume.Min.x, vertex.Position.x), std::min(m_BoundingVolume.Min.y, vertex.Position.y), std::min(m_BoundingVolume.Min.z, vertex.Position.z) };
+		m_BoundingVolume.Max = FPoint3{ std::max(m_BoundingVolume.Max.x, vertex.Position.x), std::max(m_BoundingVolume.Max.y, vertex.Position.y), std::max(m_BoundingVolume.Max.z, vertex.Position.z) };
+	}
+
+	//Sphere around the center of the box, its radius reaches the farthest vertex
+	m_BoundingVolume.Center = FPoint3{ (m_BoundingVolume.Min.x + m_BoundingVolume.Max.x) * 0.5f, (m_BoundingVolume.Min.y + m_BoundingVolume.Max.y) * 0.5f, (m_BoundingVolume.Min.z + m_BoundingVolume.Max.z) * 0.5f };
+	float radiusSquared = 0.f;
+	for (const Vertex_Input& vertex : m_VertexBuffer)
+	{
+		radiusSquared = std::max(radiusSquared, SqrMagnitude(vertex.Position - m_BoundingVolume.Center));
+	}
+	m_BoundingVolume.Radius = sqrtf(radiusSquared);
 }
 
 TriangleMesh::~TriangleMesh()
@@ -45,6 +45,9 @@ public:
 	/* Returns a const reference to the vector holding all the input vertices */
 	const std::vector<Vertex_Input>& GetVertexBuffer() const { return m_VertexBuffer; }
 
+	/* Returns const reference to the object space bounding volumes around all vertices of this triangle mesh */
+	const BoundingVolume& GetBoundingVolume() const { return m_BoundingVolume; }
+
 	/* Returns const reference to the primitive topology of this triangle mesh */
 	const EPrimitiveTopology& GetPrimitiveTopology() const { return m_PrimitiveTopology; }
 
@@ -94,6 +97,7 @@ private:
 	/* SRAS Variables */
 	std::vector<Vertex_Input> m_VertexBuffer;
 	std::vector<uint32_t> m_Indices;
+	BoundingVolume m_BoundingVolume;
 
 	/* DirectX Variables */
 	ID3D11Buffer* m_pVertexBuffer;
@@ -11,6 +11,7 @@
 //Project includes
 #include "ETimer.h"
 #include "ERenderer.h"
+#include "TextureCache.h"
 
 //Scene includes
 #include "MainScene.h"
@@ -24,10 +25,6 @@ void ShutDown(SDL_Window* pWindow)
 
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
-
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
 
@@ -42,6 +39,17 @@ int main(int argc, char* args[])
 	if (!pWindow)
 		return 1;
 
+	//Opt-in: maps get block compressed at load (lossy, changes the output of both rasterizers)
+	//The disk cache stores them compressed so they only get encoded once
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string(args[i]) == "--compress-textures")
+		{
+			TextureCache::GetInstance().SetBlockCompression(true);
+			std::cout << "Block compressed textures: ON (scalar maps don't get packed)\n";
+		}
+	}
+
 	//Initialize "framework"
 	auto pTimer{ std::make_unique<Elite::Timer>() };
 	auto pScenegraph{ std::make_unique<SceneManager>() };
@@ -94,6 +102,24 @@ int main(int argc, char* args[])
 		if (totalTimePassed >= 1000.f)
 		{
 			std::cout << "MAX FPS: " << pTimer->GetFPS() << " (CAPPED AT: " << frames << " FPS)\n";
+
+			//Images shared between materials and scenes are only decoded and stored once, they load in the background
+			//Printed every second with the rest so the LOADING count shows the background loads finishing
+			const TextureCacheStats textureStats = TextureCache::GetInstance().GetStats();
+			std::cout << "Textures - LOADED: " << textureStats.NumMisses << " MAPPED: " << textureStats.NumMapped << " SHARED: " << textureStats.NumHits << " LOADING: " << textureStats.NumLoading
+				<< " RESIDENT: " << textureStats.ResidentBytes / (1024 * 1024) << " MB\n";
+
+			//Shading cost of the software rasterizer
+			auto pCurrentScene = pScenegraph->GetCurrentScene();
+			if (pCurrentScene->GetRendererType() == ERendererType::SRAS)
+			{
+				const FrameStats& stats = pCurrentScene->GetRenderer()->GetFrameStats();
+				std::cout << "Triangles - BINNED: " << stats.NumTrianglesBinned << " CULLED: " << stats.NumTrianglesCulled << "\n";
+				std::cout << "Fragments - RASTERIZED: " << stats.NumFragmentsRasterized << " SHADED: " << stats.NumFragmentsShaded << "\n";
+#ifdef _DEBUG
+				std::cout << "Heap Allocations - " << stats.NumHeapAllocations << "\n";
+#endif
+			}
 			frames = 0;
 			totalTimePassed -= 1000.f;
 		}